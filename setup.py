@@ -1,7 +1,7 @@
 #!/usr/bin/env python
 
 import sys
-from setuptools import find_packages, setup
+from setuptools import Extension, find_packages, setup
 
 if sys.version_info < (3, 4):
     error = """
@@ -19,9 +19,21 @@ setup(
     author_email='basti@bastibe.de',
     url='https://github.com/bastibe/transplant',
     packages=find_packages(),
+    # the compiled tree walker is optional: transplant falls back to
+    # the pure-Python walk if no compiler is available.
+    ext_modules=[Extension('transplant._fastwalk',
+                           ['transplant/_fastwalk.c'],
+                           optional=True)],
     package_data={'transplant': ['parsemsgpack.m', 'dumpmsgpack.m',
+                                 'parsemsgpack_mex.c', 'dumpmsgpack_mex.c',
+                                 'build_transplant_mex.m',
                                  'parsejson.m', 'dumpjson.m',
                                  'base64decode.m', 'base64encode.m',
+                                 'base64decode_mex.c', 'base64encode_mex.c',
+                                 'zlibcompress_mex.c', 'zlibdecompress_mex.c',
+                                 'complex2bytes_mex.c', 'bytes2complex_mex.c',
+                                 '_fastwalk.c', 'gpuipc_mex.cu',
+                                 'transplantzmq_mex.c',
                                  'transplant_remote.m', 'ZMQ.m',
                                  'transplantzmq.h']},
     classifiers=[
@@ -5,8 +5,15 @@
 % to the socket.
 %
 % ZMQ Methods:
-%   receive - read a message from the socket
-%   send    - write a message to the socket
+%   receive           - read a message from the socket
+%   receive_multipart - read all frames of a message from the socket
+%   send              - write a message to the socket
+%   send_multipart    - write a multi-frame message to the socket
+%   open_pub          - open a PUB side channel for captured output
+%   publish           - write a message to the PUB side channel
+%   open_stripes      - open the parallel data sockets for striped transfers
+%   send_stripes      - write one block to each parallel data socket
+%   receive_stripes   - read one block from each parallel data socket
 
 % Copyright (c) 2016, Bastian Bechtold
 % This code is published under the terms of the BSD 3-clause license
@@ -15,10 +22,25 @@ classdef ZMQ < handle
     properties (Access=private)
         context
         socket
+        pubsocket
+        stripesockets = {}
+        usemex
     end
     methods
         function obj = ZMQ(libname, address)
             ZMQ_REP = 4;
+            % prefer the compiled transport, which avoids the slow
+            % calllib marshalling layer (see transplantzmq_mex.c):
+            obj.usemex = exist('transplantzmq_mex', 'file') == 3;
+            if obj.usemex
+                try
+                    transplantzmq_mex('open', address);
+                    return
+                catch
+                    % fall back to the calllib transport below
+                    obj.usemex = false;
+                end
+            end
             try
                 if not(libisloaded('libzmq'))
                     [notfound, warnings] = ...
@@ -30,6 +52,13 @@ classdef ZMQ < handle
                 obj.context = calllib('libzmq', 'zmq_ctx_new');
                 assert(not(obj.context.isNull), ...
                        'zmq_ctx_new failed: Could not create context');
+                % several I/O threads let striped transfers push their
+                % data sockets onto the wire concurrently; the idle
+                % threads are harmless otherwise. This must happen
+                % before the first socket is created:
+                ZMQ_IO_THREADS = 1;
+                calllib('libzmq', 'zmq_ctx_set', obj.context, ...
+                        ZMQ_IO_THREADS, 4);
                 obj.socket = calllib('libzmq', 'zmq_socket', obj.context, ZMQ_REP);
                 assert(not(obj.socket.isNull), obj.errortext('zmq_socket'));
                 err = calllib('libzmq', 'zmq_connect', obj.socket, address);
@@ -43,32 +72,151 @@ classdef ZMQ < handle
         end
 
         function str = receive(obj)
-            msg = libstruct('zmq_msg_t', struct('hidden', zeros(1, 64, 'uint8')));
-            calllib('libzmq', 'zmq_msg_init', msg); % always returns 0
-            msglen = calllib('libzmq', 'zmq_msg_recv', msg, obj.socket, 0);
-            assert(msglen >= 0, obj.errortext('zmq_msg_recv'));
-            msgptr = calllib('libzmq', 'zmq_msg_data', msg);
-            if not(msgptr.isNull)
-                setdatatype(msgptr, 'uint8Ptr', 1, msglen);
-                str = uint8(msgptr.Value);
-            else
-                str = uint8([]);
+            % all frames must be read before the socket can send again,
+            % so drain any additional frames:
+            parts = obj.receive_multipart();
+            str = parts{1};
+        end
+
+        function parts = receive_multipart(obj)
+            parts = {};
+            more = 1;
+            while more
+                [parts{end+1}, more] = obj.receive_frame(obj.socket);
             end
-            err = calllib('libzmq', 'zmq_msg_close', msg);
-            assert(err == 0, obj.errortext('zmq_msg_close'));
         end
 
         function send(obj, data)
+            if obj.usemex
+                transplantzmq_mex('send', uint8(data), false);
+                return
+            end
             dataptr = libpointer('uint8Ptr', data);
             msglen = calllib('libzmq', 'zmq_send', obj.socket, dataptr, numel(data), 0);
             assert(msglen >= 0, obj.errortext('zmq_send'));
         end
 
+        function send_multipart(obj, parts)
+            ZMQ_SNDMORE = 2;
+            if obj.usemex
+                for n=1:numel(parts)
+                    transplantzmq_mex('send', uint8(parts{n}), ...
+                                      n < numel(parts));
+                    parts{n} = []; % free each frame as soon as it is sent
+                end
+                return
+            end
+            for n=1:numel(parts)
+                data = parts{n};
+                if n < numel(parts)
+                    flags = ZMQ_SNDMORE;
+                else
+                    flags = 0;
+                end
+                dataptr = libpointer('uint8Ptr', data);
+                msglen = calllib('libzmq', 'zmq_send', obj.socket, dataptr, numel(data), flags);
+                assert(msglen >= 0, obj.errortext('zmq_send'));
+                parts{n} = []; % free each frame as soon as it is sent
+            end
+        end
+
+        function open_pub(obj, address)
+            % the PUB socket's send queue is bounded, so messages are
+            % dropped under load instead of blocking the sender:
+            ZMQ_PUB = 1;
+            ZMQ_SNDHWM = 23;
+            if obj.usemex
+                transplantzmq_mex('open_pub', address);
+                return
+            end
+            obj.pubsocket = calllib('libzmq', 'zmq_socket', obj.context, ZMQ_PUB);
+            assert(not(obj.pubsocket.isNull), obj.errortext('zmq_socket'));
+            hwm = libpointer('int32Ptr', int32(100));
+            err = calllib('libzmq', 'zmq_setsockopt', obj.pubsocket, ...
+                          ZMQ_SNDHWM, hwm, 4);
+            assert(err == 0, obj.errortext('zmq_setsockopt'));
+            err = calllib('libzmq', 'zmq_connect', obj.pubsocket, address);
+            assert(err == 0, obj.errortext('zmq_connect'));
+        end
+
+        function publish(obj, data)
+            % fire-and-forget: if the queue is full, or no PUB channel
+            % was opened, the message is silently dropped.
+            ZMQ_DONTWAIT = 1;
+            if obj.usemex
+                transplantzmq_mex('publish', uint8(data));
+                return
+            end
+            if isempty(obj.pubsocket)
+                return
+            end
+            dataptr = libpointer('uint8Ptr', data);
+            calllib('libzmq', 'zmq_send', obj.pubsocket, dataptr, ...
+                    numel(data), ZMQ_DONTWAIT);
+        end
+
+        function open_stripes(obj, urls)
+            % one PAIR socket per parallel data stream, used for
+            % striped bulk transfers (see transplant_remote):
+            ZMQ_PAIR = 0;
+            if obj.usemex
+                transplantzmq_mex('open_stripes', urls);
+                return
+            end
+            for n=1:numel(urls)
+                s = calllib('libzmq', 'zmq_socket', obj.context, ZMQ_PAIR);
+                assert(not(s.isNull), obj.errortext('zmq_socket'));
+                err = calllib('libzmq', 'zmq_connect', s, urls{n});
+                assert(err == 0, obj.errortext('zmq_connect'));
+                obj.stripesockets{n} = s;
+            end
+        end
+
+        function send_stripes(obj, blocks)
+            % each block only gets queued on its socket here; libzmq's
+            % I/O threads push the streams onto the wire concurrently.
+            if obj.usemex
+                transplantzmq_mex('send_stripes', blocks);
+                return
+            end
+            for n=1:numel(blocks)
+                data = uint8(blocks{n});
+                dataptr = libpointer('uint8Ptr', data);
+                msglen = calllib('libzmq', 'zmq_send', ...
+                                 obj.stripesockets{n}, dataptr, ...
+                                 numel(data), 0);
+                assert(msglen >= 0, obj.errortext('zmq_send'));
+            end
+        end
+
+        function blocks = receive_stripes(obj)
+            if obj.usemex
+                blocks = transplantzmq_mex('receive_stripes');
+                return
+            end
+            blocks = cell(1, numel(obj.stripesockets));
+            for n=1:numel(obj.stripesockets)
+                blocks{n} = obj.receive_frame(obj.stripesockets{n});
+            end
+        end
+
         function delete(obj)
+            if obj.usemex
+                transplantzmq_mex('close');
+                return
+            end
             % if we crashed in the constructor:
             if ~libisloaded('libzmq')
                 return
             end
+            if ~isempty(obj.pubsocket)
+                err = calllib('libzmq', 'zmq_close', obj.pubsocket);
+                assert(err == 0, obj.errortext('zmq_close'));
+            end
+            for n=1:numel(obj.stripesockets)
+                err = calllib('libzmq', 'zmq_close', obj.stripesockets{n});
+                assert(err == 0, obj.errortext('zmq_close'));
+            end
             err = calllib('libzmq', 'zmq_close', obj.socket);
             assert(err == 0, obj.errortext('zmq_close'));
             err = calllib('libzmq', 'zmq_ctx_term', obj.context);
@@ -78,6 +226,27 @@ classdef ZMQ < handle
     end
 
     methods (Hidden=true)
+        function [str, more] = receive_frame(obj, socket)
+            if obj.usemex
+                [str, more] = transplantzmq_mex('receive');
+                return
+            end
+            msg = libstruct('zmq_msg_t', struct('hidden', zeros(1, 64, 'uint8')));
+            calllib('libzmq', 'zmq_msg_init', msg); % always returns 0
+            msglen = calllib('libzmq', 'zmq_msg_recv', msg, socket, 0);
+            assert(msglen >= 0, obj.errortext('zmq_msg_recv'));
+            msgptr = calllib('libzmq', 'zmq_msg_data', msg);
+            if not(msgptr.isNull)
+                setdatatype(msgptr, 'uint8Ptr', 1, msglen);
+                str = uint8(msgptr.Value);
+            else
+                str = uint8([]);
+            end
+            more = calllib('libzmq', 'zmq_msg_more', msg);
+            err = calllib('libzmq', 'zmq_msg_close', msg);
+            assert(err == 0, obj.errortext('zmq_msg_close'));
+        end
+
         function str = errortext(obj, instruction)
             base = 156384712;
             errno = calllib('libzmq', 'zmq_errno');
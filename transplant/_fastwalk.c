@@ -0,0 +1,172 @@
+/* _FASTWALK accelerates the recursive encode/decode walks of
+ * transplant_master.py.
+ *
+ * This is a compiled drop-in replacement for the tree recursion in
+ * `_encode_values_py` and `_decode_values_py`. It walks plain dicts,
+ * lists and tuples in C, and calls back into the pure-Python
+ * implementation only for the special entries (matrices, proxy
+ * objects, tagged lists and so on), which are rare compared to the
+ * plain containers and scalars that make up large nested results.
+ *
+ * The extension is optional: setup.py builds it if a compiler is
+ * available, and transplant_master falls back to the pure-Python
+ * walk if it is not importable.
+ */
+
+/* This code is licensed under the BSD 3-clause license */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+static PyObject *encode_walk(PyObject *master, PyObject *data);
+static PyObject *decode_walk(PyObject *master, PyObject *data);
+
+/* hand one entry to the pure-Python walk, which knows about all the
+   special types */
+static PyObject *delegate(PyObject *master, const char *method,
+                          PyObject *data)
+{
+    return PyObject_CallMethod(master, method, "O", data);
+}
+
+static PyObject *walk_dict(PyObject *master, PyObject *data,
+                           PyObject *(*walk)(PyObject *, PyObject *))
+{
+    PyObject *out, *key, *value, *walked;
+    Py_ssize_t pos = 0;
+    out = PyDict_New();
+    if (out == NULL)
+        return NULL;
+    while (PyDict_Next(data, &pos, &key, &value)) {
+        walked = walk(master, value);
+        if (walked == NULL || PyDict_SetItem(out, key, walked) < 0) {
+            Py_XDECREF(walked);
+            Py_DECREF(out);
+            return NULL;
+        }
+        Py_DECREF(walked);
+    }
+    return out;
+}
+
+static PyObject *walk_sequence(PyObject *master, PyObject *data,
+                               PyObject *(*walk)(PyObject *, PyObject *))
+{
+    PyObject *out, *walked;
+    Py_ssize_t len, n;
+    len = PySequence_Fast_GET_SIZE(data);
+    out = PyList_New(len);
+    if (out == NULL)
+        return NULL;
+    for (n = 0; n < len; n++) {
+        walked = walk(master, PySequence_Fast_GET_ITEM(data, n));
+        if (walked == NULL) {
+            Py_DECREF(out);
+            return NULL;
+        }
+        PyList_SET_ITEM(out, n, walked);
+    }
+    return out;
+}
+
+/* like `_encode_values_py`, but plain scalars and containers are
+   handled without calling back into Python */
+static PyObject *encode_walk(PyObject *master, PyObject *data)
+{
+    PyObject *out;
+    if (data == Py_None || PyBool_Check(data) ||
+        PyLong_CheckExact(data) || PyFloat_CheckExact(data) ||
+        PyUnicode_CheckExact(data) || PyBytes_CheckExact(data)) {
+        Py_INCREF(data);
+        return data;
+    }
+    if (PyDict_CheckExact(data)) {
+        if (Py_EnterRecursiveCall(" in transplant._fastwalk"))
+            return NULL;
+        out = walk_dict(master, data, encode_walk);
+        Py_LeaveRecursiveCall();
+        return out;
+    }
+    if (PyList_CheckExact(data) || PyTuple_CheckExact(data)) {
+        if (Py_EnterRecursiveCall(" in transplant._fastwalk"))
+            return NULL;
+        out = walk_sequence(master, data, encode_walk);
+        Py_LeaveRecursiveCall();
+        return out;
+    }
+    /* special entries (matrices, proxies, structs, ...) and unknown
+       types: */
+    return delegate(master, "_encode_values_py", data);
+}
+
+/* like `_decode_values_py`, but only lists tagged with a "__...__"
+   string are handed back to Python */
+static PyObject *decode_walk(PyObject *master, PyObject *data)
+{
+    PyObject *out;
+    if (PyDict_CheckExact(data)) {
+        if (Py_EnterRecursiveCall(" in transplant._fastwalk"))
+            return NULL;
+        out = walk_dict(master, data, decode_walk);
+        Py_LeaveRecursiveCall();
+        return out;
+    }
+    if (PyList_CheckExact(data)) {
+        if (PyList_GET_SIZE(data) > 0) {
+            PyObject *tag = PyList_GET_ITEM(data, 0);
+            if (PyUnicode_Check(tag) && PyUnicode_GET_LENGTH(tag) > 2 &&
+                PyUnicode_ReadChar(tag, 0) == '_' &&
+                PyUnicode_ReadChar(tag, 1) == '_')
+                return delegate(master, "_decode_values_py", data);
+        }
+        if (Py_EnterRecursiveCall(" in transplant._fastwalk"))
+            return NULL;
+        out = walk_sequence(master, data, decode_walk);
+        Py_LeaveRecursiveCall();
+        return out;
+    }
+    if (PyTuple_CheckExact(data)) {
+        if (Py_EnterRecursiveCall(" in transplant._fastwalk"))
+            return NULL;
+        out = walk_sequence(master, data, decode_walk);
+        Py_LeaveRecursiveCall();
+        return out;
+    }
+    Py_INCREF(data);
+    return data;
+}
+
+static PyObject *fastwalk_encode_values(PyObject *self, PyObject *args)
+{
+    PyObject *master, *data;
+    if (!PyArg_ParseTuple(args, "OO", &master, &data))
+        return NULL;
+    return encode_walk(master, data);
+}
+
+static PyObject *fastwalk_decode_values(PyObject *self, PyObject *args)
+{
+    PyObject *master, *data;
+    if (!PyArg_ParseTuple(args, "OO", &master, &data))
+        return NULL;
+    return decode_walk(master, data);
+}
+
+static PyMethodDef fastwalk_methods[] = {
+    {"encode_values", fastwalk_encode_values, METH_VARARGS,
+     "encode_values(master, data): encode special entries in data"},
+    {"decode_values", fastwalk_decode_values, METH_VARARGS,
+     "decode_values(master, data): decode special entries in data"},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef fastwalk_module = {
+    PyModuleDef_HEAD_INIT, "_fastwalk",
+    "compiled encode/decode tree walker for transplant_master",
+    -1, fastwalk_methods
+};
+
+PyMODINIT_FUNC PyInit__fastwalk(void)
+{
+    return PyModule_Create(&fastwalk_module);
+}
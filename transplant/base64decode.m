@@ -8,6 +8,17 @@
 % This code is licensed under the BSD 3-clause license
 
 function bytes = base64decode(base64)
+    % use the compiled codec if it is available (see
+    % build_transplant_mex.m):
+    persistent use_mex
+    if isempty(use_mex)
+        use_mex = exist('base64decode_mex', 'file') == 3;
+    end
+    if use_mex
+        bytes = base64decode_mex(base64);
+        return
+    end
+
     % strip line breaks
     base64 = strrep(base64, sprintf('\n'), '');
     % add padding if missing
@@ -0,0 +1,69 @@
+/* BASE64DECODE_MEX decodes a base64 string as a vector of uint8s
+ *
+ * This is a compiled drop-in replacement for base64decode.m. It
+ * decodes in a single tight loop instead of building the large
+ * intermediate index matrices of the pure-Matlab implementation.
+ * Line breaks are skipped, just like in base64decode.m. Compile it
+ * with build_transplant_mex.m; base64decode.m falls back to the
+ * pure-Matlab code if this file is not compiled.
+ */
+
+/* This code is licensed under the BSD 3-clause license */
+
+#include <stdint.h>
+#include <string.h>
+#include "mex.h"
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    const mxChar *base64;
+    size_t len, n, nbytes = 0;
+    uint8_t table[128];
+    uint8_t *bytes;
+    uint32_t block = 0;
+    int nchars = 0;
+
+    if (nrhs != 1 || !mxIsChar(prhs[0]))
+        mexErrMsgIdAndTxt("transplant:base64decode:argument",
+                          "base64decode_mex requires a char array");
+    base64 = (const mxChar*)mxGetData(prhs[0]);
+    len = mxGetNumberOfElements(prhs[0]);
+
+    memset(table, 255, sizeof(table));
+    for (n = 0; n < 26; n++) table['A' + n] = (uint8_t)n;
+    for (n = 0; n < 26; n++) table['a' + n] = (uint8_t)(26 + n);
+    for (n = 0; n < 10; n++) table['0' + n] = (uint8_t)(52 + n);
+    table['+'] = 62;
+    table['/'] = 63;
+
+    /* every four characters decode to at most three bytes */
+    plhs[0] = mxCreateNumericMatrix((len + 3) / 4 * 3, 1,
+                                    mxUINT8_CLASS, mxREAL);
+    bytes = (uint8_t*)mxGetData(plhs[0]);
+
+    for (n = 0; n < len; n++) {
+        uint8_t value;
+        if (base64[n] == '\n' || base64[n] == '=' || base64[n] > 127)
+            continue;
+        value = table[base64[n]];
+        if (value == 255)
+            continue;
+        block = (block << 6) | value;
+        if (++nchars == 4) {
+            bytes[nbytes++] = (uint8_t)(block >> 16);
+            bytes[nbytes++] = (uint8_t)(block >> 8);
+            bytes[nbytes++] = (uint8_t)block;
+            block = 0;
+            nchars = 0;
+        }
+    }
+    /* flush a padded final block */
+    if (nchars == 3) {
+        bytes[nbytes++] = (uint8_t)(block >> 10);
+        bytes[nbytes++] = (uint8_t)(block >> 2);
+    } else if (nchars == 2) {
+        bytes[nbytes++] = (uint8_t)(block >> 4);
+    }
+
+    mxSetM(plhs[0], nbytes); /* shrink to the actual length */
+}
@@ -8,6 +8,17 @@
 % This code is licensed under the BSD 3-clause license
 
 function base64 = base64encode(bytes)
+    % use the compiled codec if it is available (see
+    % build_transplant_mex.m):
+    persistent use_mex
+    if isempty(use_mex)
+        use_mex = exist('base64encode_mex', 'file') == 3;
+    end
+    if use_mex
+        base64 = base64encode_mex(uint8(bytes));
+        return
+    end
+
     % pad the base64 string to a multiple of 3
     if mod(length(bytes), 3) ~= 0
         padding = 3-mod(length(bytes), 3);
@@ -0,0 +1,58 @@
+/* BASE64ENCODE_MEX encodes a vector of uint8s as a base64 string
+ *
+ * This is a compiled drop-in replacement for base64encode.m. It
+ * encodes in a single tight loop over three-byte blocks, which
+ * compilers readily vectorize, instead of building the large
+ * intermediate index matrices of the pure-Matlab implementation.
+ * Compile it with build_transplant_mex.m; base64encode.m falls back
+ * to the pure-Matlab code if this file is not compiled.
+ */
+
+/* This code is licensed under the BSD 3-clause license */
+
+#include <stdint.h>
+#include "mex.h"
+
+static const char table[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    const uint8_t *bytes;
+    size_t len, blocks, n;
+    mxChar *base64;
+    mwSize dims[2];
+
+    if (nrhs != 1 || !mxIsUint8(prhs[0]))
+        mexErrMsgIdAndTxt("transplant:base64encode:argument",
+                          "base64encode_mex requires a uint8 array");
+    bytes = (const uint8_t*)mxGetData(prhs[0]);
+    len = mxGetNumberOfElements(prhs[0]);
+    blocks = (len + 2) / 3;
+
+    dims[0] = 1;
+    dims[1] = blocks * 4;
+    plhs[0] = mxCreateCharArray(2, dims);
+    base64 = (mxChar*)mxGetData(plhs[0]);
+
+    /* convert every three bytes into four base64 characters */
+    for (n = 0; n + 3 <= len; n += 3) {
+        uint32_t block = ((uint32_t)bytes[n] << 16) |
+                         ((uint32_t)bytes[n+1] << 8) |
+                         (uint32_t)bytes[n+2];
+        *base64++ = table[(block >> 18) & 63];
+        *base64++ = table[(block >> 12) & 63];
+        *base64++ = table[(block >> 6) & 63];
+        *base64++ = table[block & 63];
+    }
+    /* pad the last block with '=' */
+    if (n < len) {
+        uint32_t block = (uint32_t)bytes[n] << 16;
+        if (n + 1 < len)
+            block |= (uint32_t)bytes[n+1] << 8;
+        *base64++ = table[(block >> 18) & 63];
+        *base64++ = table[(block >> 12) & 63];
+        *base64++ = (n + 1 < len) ? table[(block >> 6) & 63] : '=';
+        *base64++ = '=';
+    }
+}
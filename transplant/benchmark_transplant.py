@@ -0,0 +1,62 @@
+"""Performance benchmarks for Transplant.
+
+These complement the correctness tests in test_transplant.py: they
+measure round-trip latency and transfer throughput, so regressions in
+the encoders (dumpmsgpack.m, _encode_values) or the ZMQ path show up
+as numbers instead of user complaints.
+
+Run them with pytest-benchmark, and emit JSON for tracking across
+releases:
+
+    py.test benchmark_transplant.py --benchmark-json=benchmarks.json
+
+The large matrix sizes transfer up to a gigabyte per round trip;
+deselect them with ``-k 'not 1GB'`` for a quick run.
+
+"""
+
+from transplant import Matlab
+import numpy as np
+import pytest
+
+pytest.importorskip('pytest_benchmark')
+
+# 1 KB to 1 GB, in steps of 32; the ids name the sizes, so single
+# sizes can be (de)selected with -k:
+matrix_bytes = [pytest.param(2**10, id='1KB'),
+                pytest.param(2**15, id='32KB'),
+                pytest.param(2**20, id='1MB'),
+                pytest.param(2**25, id='32MB'),
+                pytest.param(2**30, id='1GB')]
+
+@pytest.yield_fixture(scope='module', params=['msgpack', 'json'])
+def matlab(request):
+    matlab = Matlab(jvm=False, msgformat=request.param)
+    yield matlab
+    del matlab
+
+def test_empty_call_latency(matlab, benchmark):
+    # a call with no arguments and no useful return value measures the
+    # fixed per-message cost of the transport:
+    benchmark(matlab.eval, '0;', nargout=0)
+
+@pytest.mark.parametrize('nbytes', matrix_bytes)
+def test_matrix_send_throughput(matlab, benchmark, nbytes):
+    data = np.zeros(nbytes // 8)
+    benchmark(matlab.numel, data)
+
+@pytest.mark.parametrize('nbytes', matrix_bytes)
+def test_matrix_receive_throughput(matlab, benchmark, nbytes):
+    benchmark(matlab.zeros, 1, nbytes // 8)
+
+def test_nested_struct_round_trip(matlab, benchmark):
+    leaf = dict(name='leaf', data=np.arange(100), flag=True)
+    tree = dict(left=dict(left=leaf, right=leaf),
+                right=dict(left=leaf, right=leaf))
+    # fieldnames only touches the outer level, so this measures
+    # encode/decode cost of the nested struct, not Matlab work:
+    benchmark(matlab.fieldnames, tree)
+
+def test_proxy_attribute_access(matlab, benchmark):
+    obj = matlab.containers.Map()
+    benchmark(lambda: obj.Count)
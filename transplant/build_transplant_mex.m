@@ -0,0 +1,40 @@
+%BUILD_TRANSPLANT_MEX compiles the optional transplant MEX accelerators
+% BUILD_TRANSPLANT_MEX()
+%    compiles the MEX files that accelerate transplant's hot paths.
+%    Each accelerator is optional: transplant_remote falls back to the
+%    pure-Matlab implementation of any accelerator that is not
+%    compiled. Compilation failures are reported as warnings, so a
+%    partially working compiler setup still builds the remaining
+%    accelerators.
+
+% This code is licensed under the BSD 3-clause license
+
+function build_transplant_mex()
+    here = fileparts(mfilename('fullpath'));
+    % each entry is a source file, followed by additional mex arguments:
+    sources = {{'dumpmsgpack_mex.c'}, {'parsemsgpack_mex.c'}, ...
+               {'base64encode_mex.c'}, {'base64decode_mex.c'}, ...
+               {'zlibcompress_mex.c', '-lz'}, {'zlibdecompress_mex.c', '-lz'}, ...
+               {'complex2bytes_mex.c', '-R2018a'}, ...
+               {'bytes2complex_mex.c', '-R2018a'}, ...
+               {'transplantzmq_mex.c', '-lzmq'}};
+    for n=1:length(sources)
+        source = sources{n};
+        try
+            mex('-outdir', here, fullfile(here, source{1}), source{2:end});
+        catch err
+            warning('transplant:buildmex:failed', ...
+                    ['Could not compile ' source{1} ': ' err.message]);
+        end
+    end
+    % the GPU IPC exporter needs the CUDA toolchain and the parallel
+    % computing toolbox, and is only useful on machines with a GPU:
+    if exist('mexcuda', 'file')
+        try
+            mexcuda('-outdir', here, fullfile(here, 'gpuipc_mex.cu'));
+        catch err
+            warning('transplant:buildmex:failed', ...
+                    ['Could not compile gpuipc_mex.cu: ' err.message]);
+        end
+    end
+end
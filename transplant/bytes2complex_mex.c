@@ -0,0 +1,42 @@
+/* BYTES2COMPLEX_MEX builds a complex array from interleaved bytes
+ *
+ * This is a compiled fast path for the complex branch of
+ * decode_matrix in transplant_remote.m. The wire format stores
+ * complex data interleaved ([real, imag, real, imag, ...]), which
+ * matches Matlab's own storage with the -R2018a API, so the bytes
+ * can be copied into the result in one pass instead of being split
+ * into real and imaginary parts element-wise. Compile it with
+ * build_transplant_mex.m; transplant_remote falls back to the
+ * pure-Matlab de-interleaving if this file is not compiled.
+ */
+
+/* This code is licensed under the BSD 3-clause license */
+
+#include <string.h>
+#include "mex.h"
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    char classname[16];
+    size_t nbytes;
+
+    if (nrhs != 2 || !mxIsUint8(prhs[0]) || !mxIsChar(prhs[1]))
+        mexErrMsgIdAndTxt("transplant:bytes2complex:argument",
+                          "bytes2complex_mex requires a uint8 array "
+                          "and a class name");
+    mxGetString(prhs[1], classname, sizeof(classname));
+    nbytes = mxGetNumberOfElements(prhs[0]);
+
+    if (strcmp(classname, "double") == 0) {
+        plhs[0] = mxCreateNumericMatrix(nbytes / (2*sizeof(double)), 1,
+                                        mxDOUBLE_CLASS, mxCOMPLEX);
+        memcpy(mxGetComplexDoubles(plhs[0]), mxGetData(prhs[0]), nbytes);
+    } else if (strcmp(classname, "single") == 0) {
+        plhs[0] = mxCreateNumericMatrix(nbytes / (2*sizeof(float)), 1,
+                                        mxSINGLE_CLASS, mxCOMPLEX);
+        memcpy(mxGetComplexSingles(plhs[0]), mxGetData(prhs[0]), nbytes);
+    } else {
+        mexErrMsgIdAndTxt("transplant:bytes2complex:argument",
+                          "class name must be 'double' or 'single'");
+    }
+}
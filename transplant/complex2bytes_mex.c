@@ -0,0 +1,38 @@
+/* COMPLEX2BYTES_MEX reads the bytes of a complex array in one pass
+ *
+ * This is a compiled fast path for the complex branch of
+ * encode_matrix in transplant_remote.m. It is built with the -R2018a
+ * API, where Matlab stores complex data interleaved ([real, imag,
+ * real, imag, ...]), so the wire bytes can be copied out directly
+ * instead of being assembled element-wise from the real and
+ * imaginary parts. Compile it with build_transplant_mex.m;
+ * transplant_remote falls back to the pure-Matlab interleaving if
+ * this file is not compiled.
+ */
+
+/* This code is licensed under the BSD 3-clause license */
+
+#include <string.h>
+#include "mex.h"
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    size_t nbytes;
+    const void *src;
+
+    if (nrhs != 1 || !mxIsComplex(prhs[0]) ||
+        !(mxIsDouble(prhs[0]) || mxIsSingle(prhs[0])))
+        mexErrMsgIdAndTxt("transplant:complex2bytes:argument",
+                          "complex2bytes_mex requires a complex "
+                          "double or single array");
+    if (mxIsDouble(prhs[0])) {
+        nbytes = mxGetNumberOfElements(prhs[0]) * 2 * sizeof(double);
+        src = mxGetComplexDoubles(prhs[0]);
+    } else {
+        nbytes = mxGetNumberOfElements(prhs[0]) * 2 * sizeof(float);
+        src = mxGetComplexSingles(prhs[0]);
+    }
+
+    plhs[0] = mxCreateNumericMatrix(nbytes, 1, mxUINT8_CLASS, mxREAL);
+    memcpy(mxGetData(plhs[0]), src, nbytes);
+}
@@ -77,8 +77,12 @@ function [json] = string(data)
     data = strrep(data, sprintf('\r'), '\r');
     data = strrep(data, sprintf('\t'), '\t');
     % convert non-ASCII characters to `\uXXXX` sequences, where XXX is
-    % the hex unicode codepoint of the character.
-    data = regexprep(data, '([^\x00-\x7F])', '\\u${sprintf(''%04s'', dec2hex($1))}');
+    % the hex unicode codepoint of the character. The regexprep is
+    % very slow, so a vectorized comparison checks whether there is
+    % anything to convert at all first:
+    if any(data > 127)
+        data = regexprep(data, '([^\x00-\x7F])', '\\u${sprintf(''%04s'', dec2hex($1))}');
+    end
     json = sprintf('"%s"', data);
 end
 
@@ -113,54 +117,44 @@ end
 
 % dumps a one-dimensional array of values as an array
 function [json] = array(data)
-    json = '[';
-    for idx=1:length(data)
-        json = [json value(data(idx))];
-        if idx < length(data)
-            json = [json ','];
-        end
+    % numeric and logical arrays are formatted in one bulk sprintf
+    % instead of one recursive value() call per element:
+    if isinteger(data)
+        body = sprintf('%i,', data);
+        json = ['[' body(1:end-1) ']'];
+    elseif isnumeric(data)
+        body = sprintf('%.50g,', data);
+        json = ['[' body(1:end-1) ']'];
+    elseif islogical(data)
+        words = {'false', 'true'};
+        json = ['[' strjoin(words(data(:)'+1), ',') ']'];
+    else
+        % struct arrays and the like still go element by element:
+        parts = arrayfun(@value, data, 'uniformoutput', false);
+        json = ['[' strjoin(parts(:)', ',') ']'];
     end
-    json = [json ']'];
 end
 
 % dumps a one-dimensional cell array of values as an array
 function [json] = cell(data)
-    json = '[';
-    for idx=1:length(data)
-        json = [json value(data{idx})];
-        if idx < length(data)
-            json = [json ','];
-        end
-    end
-    json = [json ']'];
+    parts = cellfun(@value, data, 'uniformoutput', false);
+    json = ['[' strjoin(parts(:)', ',') ']'];
 end
 
 % dumps a 0-dimensional container.Map as an object
 function [json] = map(data)
-    json = '{';
     keys = data.keys();
-    for idx=1:length(keys)
-        key = keys{idx};
-        json = [json value(key) ':' value(data(key))];
-        if idx < length(keys)
-            json = [json ','];
-        end
-    end
-    json = [json '}'];
+    pair = @(key) [value(key) ':' value(data(key))];
+    parts = cellfun(pair, keys, 'uniformoutput', false);
+    json = ['{' strjoin(parts(:)', ',') '}'];
 end
 
 % dumps a 0-dimensional struct as an object
 function [json] = struct(data)
-    json = '{';
     keys = fieldnames(data);
-    for idx=1:length(keys)
-        key = keys{idx};
-        json = [json value(key) ':' value(data.(key))];
-        if idx < length(keys)
-            json = [json ','];
-        end
-    end
-    json = [json '}'];
+    pair = @(key) [value(key) ':' value(data.(key))];
+    parts = cellfun(pair, keys, 'uniformoutput', false);
+    json = ['{' strjoin(parts(:)', ',') '}'];
 end
 
 % dumps `null`
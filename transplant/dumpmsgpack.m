@@ -1,6 +1,11 @@
 %DUMPMSGPACK dumps Matlab data structures as a msgpack data
 % DUMPMSGPACK(DATA)
 %    recursively walks through DATA and creates a msgpack byte buffer from it.
+% DUMPMSGPACK(DATA, USEEXT)
+%    additionally wraps transplant's special cell arrays (the ones
+%    tagged '__matrix__', '__sparse__' and so on) in msgpack ext
+%    values of type 42, so that the receiver can recognize them
+%    during unpacking instead of walking the whole decoded tree.
 %    - strings are converted to strings
 %    - scalars are converted to numbers
 %    - logicals are converted to `true` and `false`
@@ -13,18 +18,36 @@
 %    - structs and container.Maps are converted to maps
 %    - function handles and matlab objects will raise an error.
 %
-%    There is no way of encoding bins or exts
+%    There is no way of encoding bins or exts other than type 42
 
 % (c) 2016 Bastian Bechtold
 % This code is licensed under the BSD 3-clause license
 
-function msgpack = dumpmsgpack(data)
+function msgpack = dumpmsgpack(data, useext)
+    if nargin < 2
+        useext = false;
+    end
+    use_ext(useext);
     msgpack = dump(data);
     % collect all parts in a cell array to avoid frequent uint8
     % concatenations.
     msgpack = [msgpack{:}];
 end
 
+function flag = use_ext(enable)
+    % remembers whether special cells should be dumped as ext values
+    % (set by dumpmsgpack, read by dumpcell; subfunctions don't share
+    % scope, so this avoids threading the flag through every dump)
+    persistent enabled
+    if isempty(enabled)
+        enabled = false;
+    end
+    if nargin > 0
+        enabled = enable;
+    end
+    flag = enabled;
+end
+
 function msgpack = dump(data)
     % convert numeric matrices to cell matrices since msgpack doesn't know matrices
     if (isnumeric(data) || islogical(data)) && ...
@@ -167,6 +190,20 @@ end
 function msgpack = dumpcell(value)
     b10010000 = 144;
 
+    % wrap transplant's tagged cells in an ext value, so the receiver
+    % can decode them during unpacking instead of walking the tree:
+    if use_ext() && ~isempty(value) && ischar(value{1}) && ...
+       any(strcmp(value{1}, {'__matrix__', '__shm_matrix__', ...
+                             '__chunked_matrix__', '__striped_matrix__', ...
+                             '__sparse__', ...
+                             '__sparse_csc__', '__object__', ...
+                             '__function__', '__matrix_handle__', ...
+                             '__string_array__', '__number_array__', ...
+                             '__gpu_matrix__'}))
+        msgpack = dumpext(value);
+        return
+    end
+
     % Msgpack can only work with 1D-arrays. Thus, Convert a
     % multidimensional AxBxC array into a cell-of-cell-of-cell, so
     % that indexing value{a, b, c} becomes value{a}{b}{c}.
@@ -198,6 +235,28 @@ function msgpack = dumpcell(value)
     end
 end
 
+function msgpack = dumpext(value)
+    % dump the payload with ext disabled, so that tagged cells nested
+    % inside the payload (such as a sparse matrix's index vectors)
+    % stay plain msgpack:
+    use_ext(false);
+    payload = dump(value);
+    use_ext(true);
+    payload = [payload{:}];
+
+    len = length(payload);
+    if len < 256 % encode as ext8
+        msgpack = {uint8([199, len, 42]), payload};
+    elseif len < 2^16 % encode as ext16
+        msgpack = {uint8(200), scalar2bytes(uint16(len)), uint8(42), payload};
+    elseif len < 2^32 % encode as ext32
+        msgpack = {uint8(201), scalar2bytes(uint32(len)), uint8(42), payload};
+    else
+        error('transplant:dumpmsgpack:exttoolong', ...
+              sprintf('Ext is too long (%d bytes)', len));
+    end
+end
+
 function msgpack = dumpmap(value)
     b10000000 = 128;
 
@@ -0,0 +1,525 @@
+/* DUMPMSGPACK_MEX dumps Matlab data structures as msgpack data
+ *
+ * This is a compiled drop-in replacement for dumpmsgpack.m. It walks
+ * the same data types and produces byte-identical msgpack output, but
+ * without the per-element recursion overhead of the pure-Matlab
+ * implementation. Compile it with build_transplant_mex.m; transplant
+ * falls back to dumpmsgpack.m if this file is not compiled.
+ *
+ * An optional second argument enables wrapping transplant's special
+ * cell arrays in msgpack ext values of type 42, so that the receiver
+ * can recognize them during unpacking instead of walking the whole
+ * decoded tree.
+ *
+ * See dumpmsgpack.m for the documentation of the encoding rules.
+ */
+
+/* This code is licensed under the BSD 3-clause license */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mex.h"
+
+/* a growable byte buffer for assembling the msgpack data */
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} buffer_t;
+
+static void buffer_reserve(buffer_t *buf, size_t extra)
+{
+    size_t newcap;
+    if (buf->len + extra <= buf->cap)
+        return;
+    newcap = buf->cap ? buf->cap : 1024;
+    while (newcap < buf->len + extra)
+        newcap *= 2;
+    buf->data = mxRealloc(buf->data, newcap);
+    buf->cap = newcap;
+}
+
+static void put_bytes(buffer_t *buf, const uint8_t *bytes, size_t n)
+{
+    buffer_reserve(buf, n);
+    memcpy(buf->data + buf->len, bytes, n);
+    buf->len += n;
+}
+
+static void put_byte(buffer_t *buf, uint8_t byte)
+{
+    put_bytes(buf, &byte, 1);
+}
+
+/* msgpack stores all multi-byte values in big-endian byte order */
+static void put_be16(buffer_t *buf, uint16_t value)
+{
+    uint8_t bytes[2] = {(uint8_t)(value >> 8), (uint8_t)value};
+    put_bytes(buf, bytes, 2);
+}
+
+static void put_be32(buffer_t *buf, uint32_t value)
+{
+    uint8_t bytes[4] = {(uint8_t)(value >> 24), (uint8_t)(value >> 16),
+                        (uint8_t)(value >> 8), (uint8_t)value};
+    put_bytes(buf, bytes, 4);
+}
+
+static void put_be64(buffer_t *buf, uint64_t value)
+{
+    uint8_t bytes[8] = {(uint8_t)(value >> 56), (uint8_t)(value >> 48),
+                        (uint8_t)(value >> 40), (uint8_t)(value >> 32),
+                        (uint8_t)(value >> 24), (uint8_t)(value >> 16),
+                        (uint8_t)(value >> 8), (uint8_t)value};
+    put_bytes(buf, bytes, 8);
+}
+
+static void dump(const mxArray *data, buffer_t *buf);
+
+/* whether special cells are wrapped in ext values (set per call from
+   the optional second argument of the mexFunction) */
+static int use_ext = 0;
+
+/* encode one element of a numeric or logical array, like dumpinteger,
+   dumpfloat and the logical branch of dump in dumpmsgpack.m */
+static void dump_scalar(const mxArray *data, size_t idx, buffer_t *buf)
+{
+    if (mxIsComplex(data))
+        mexErrMsgIdAndTxt("transplant:dumpmsgpack:unknowntype",
+                          "Cannot encode complex values");
+    switch (mxGetClassID(data)) {
+    case mxLOGICAL_CLASS:
+        put_byte(buf, ((mxLogical*)mxGetData(data))[idx] ? 195 : 194);
+        return;
+    case mxDOUBLE_CLASS: {
+        double value = ((double*)mxGetData(data))[idx];
+        uint64_t bits;
+        memcpy(&bits, &value, 8);
+        put_byte(buf, 203);
+        put_be64(buf, bits);
+        return;
+    }
+    case mxSINGLE_CLASS: {
+        float value = ((float*)mxGetData(data))[idx];
+        uint32_t bits;
+        memcpy(&bits, &value, 4);
+        put_byte(buf, 202);
+        put_be32(buf, bits);
+        return;
+    }
+    case mxUINT8_CLASS: {
+        uint8_t value = ((uint8_t*)mxGetData(data))[idx];
+        if (value < 128) {
+            put_byte(buf, value); /* positive fixnum */
+        } else {
+            put_byte(buf, 204);
+            put_byte(buf, value);
+        }
+        return;
+    }
+    case mxUINT16_CLASS: {
+        uint16_t value = ((uint16_t*)mxGetData(data))[idx];
+        if (value < 128) {
+            put_byte(buf, (uint8_t)value);
+        } else {
+            put_byte(buf, 205);
+            put_be16(buf, value);
+        }
+        return;
+    }
+    case mxUINT32_CLASS: {
+        uint32_t value = ((uint32_t*)mxGetData(data))[idx];
+        if (value < 128) {
+            put_byte(buf, (uint8_t)value);
+        } else {
+            put_byte(buf, 206);
+            put_be32(buf, value);
+        }
+        return;
+    }
+    case mxUINT64_CLASS: {
+        uint64_t value = ((uint64_t*)mxGetData(data))[idx];
+        if (value < 128) {
+            put_byte(buf, (uint8_t)value);
+        } else {
+            put_byte(buf, 207);
+            put_be64(buf, value);
+        }
+        return;
+    }
+    case mxINT8_CLASS: {
+        int8_t value = ((int8_t*)mxGetData(data))[idx];
+        if (value >= 0 && value < 128) {
+            put_byte(buf, (uint8_t)value); /* positive fixnum */
+        } else if (value < 0 && value > -32) {
+            put_byte(buf, (uint8_t)value); /* negative fixnum */
+        } else {
+            put_byte(buf, 208);
+            put_byte(buf, (uint8_t)value);
+        }
+        return;
+    }
+    case mxINT16_CLASS: {
+        int16_t value = ((int16_t*)mxGetData(data))[idx];
+        if (value >= 0 && value < 128) {
+            put_byte(buf, (uint8_t)value);
+        } else if (value < 0 && value > -32) {
+            put_byte(buf, (uint8_t)(int8_t)value);
+        } else {
+            put_byte(buf, 209);
+            put_be16(buf, (uint16_t)value);
+        }
+        return;
+    }
+    case mxINT32_CLASS: {
+        int32_t value = ((int32_t*)mxGetData(data))[idx];
+        if (value >= 0 && value < 128) {
+            put_byte(buf, (uint8_t)value);
+        } else if (value < 0 && value > -32) {
+            put_byte(buf, (uint8_t)(int8_t)value);
+        } else {
+            put_byte(buf, 210);
+            put_be32(buf, (uint32_t)value);
+        }
+        return;
+    }
+    case mxINT64_CLASS: {
+        int64_t value = ((int64_t*)mxGetData(data))[idx];
+        if (value >= 0 && value < 128) {
+            put_byte(buf, (uint8_t)value);
+        } else if (value < 0 && value > -32) {
+            put_byte(buf, (uint8_t)(int8_t)value);
+        } else {
+            put_byte(buf, 211);
+            put_be64(buf, (uint64_t)value);
+        }
+        return;
+    }
+    default:
+        mexErrMsgIdAndTxt("transplant:dumpmsgpack:unknowntype",
+                          "Unknown type \"%s\"", mxGetClassName(data));
+    }
+}
+
+static void dump_array_header(buffer_t *buf, size_t len)
+{
+    if (len < 16) { /* encode as fixarray */
+        put_byte(buf, (uint8_t)(144 | len));
+    } else if (len < 65536) { /* encode as array16 */
+        put_byte(buf, 220);
+        put_be16(buf, (uint16_t)len);
+    } else { /* encode as array32 */
+        put_byte(buf, 221);
+        put_be32(buf, (uint32_t)len);
+    }
+}
+
+static void dump_map_header(buffer_t *buf, size_t len)
+{
+    if (len < 16) { /* encode as fixmap */
+        put_byte(buf, (uint8_t)(128 | len));
+    } else if (len < 65536) { /* encode as map16 */
+        put_byte(buf, 222);
+        put_be16(buf, (uint16_t)len);
+    } else { /* encode as map32 */
+        put_byte(buf, 223);
+        put_be32(buf, (uint32_t)len);
+    }
+}
+
+static void dump_str_header(buffer_t *buf, size_t len)
+{
+    if (len < 32) { /* encode as fixstr */
+        put_byte(buf, (uint8_t)(160 | len));
+    } else if (len < 256) { /* encode as str8 */
+        put_byte(buf, 217);
+        put_byte(buf, (uint8_t)len);
+    } else if (len < 65536) { /* encode as str16 */
+        put_byte(buf, 218);
+        put_be16(buf, (uint16_t)len);
+    } else { /* encode as str32 */
+        put_byte(buf, 219);
+        put_be32(buf, (uint32_t)len);
+    }
+}
+
+static void dump_string(const mxArray *data, buffer_t *buf)
+{
+    size_t len = mxGetNumberOfElements(data);
+    const mxChar *chars = (const mxChar*)mxGetData(data);
+    size_t n;
+    int is_ascii = 1;
+    for (n = 0; n < len; n++) {
+        if (chars[n] > 127) {
+            is_ascii = 0;
+            break;
+        }
+    }
+    if (is_ascii) {
+        dump_str_header(buf, len);
+        buffer_reserve(buf, len);
+        for (n = 0; n < len; n++)
+            buf->data[buf->len++] = (uint8_t)chars[n];
+    } else {
+        /* non-ASCII strings go through Matlab's UTF-8 encoder */
+        mxArray *argin[2], *encoded;
+        argin[0] = (mxArray*)data;
+        argin[1] = mxCreateString("utf-8");
+        mexCallMATLAB(1, &encoded, 2, argin, "unicode2native");
+        len = mxGetNumberOfElements(encoded);
+        dump_str_header(buf, len);
+        put_bytes(buf, (const uint8_t*)mxGetData(encoded), len);
+        mxDestroyArray(encoded);
+        mxDestroyArray(argin[1]);
+    }
+}
+
+static void dump_bin(const mxArray *data, buffer_t *buf)
+{
+    size_t len = mxGetNumberOfElements(data);
+    if (len < 256) { /* encode as bin8 */
+        put_byte(buf, 196);
+        put_byte(buf, (uint8_t)len);
+    } else if (len < 65536) { /* encode as bin16 */
+        put_byte(buf, 197);
+        put_be16(buf, (uint16_t)len);
+    } else { /* encode as bin32 */
+        put_byte(buf, 198);
+        put_be32(buf, (uint32_t)len);
+    }
+    put_bytes(buf, (const uint8_t*)mxGetData(data), len);
+}
+
+typedef struct {
+    const char *name;
+    int field;
+} field_entry_t;
+
+static int compare_fields(const void *a, const void *b)
+{
+    return strcmp(((const field_entry_t*)a)->name,
+                  ((const field_entry_t*)b)->name);
+}
+
+/* encode a struct array element as a map, like dumpmap in dumpmsgpack.m */
+static void dump_struct(const mxArray *data, size_t idx, buffer_t *buf)
+{
+    int nfields = mxGetNumberOfFields(data);
+    int n;
+    field_entry_t *fields = mxMalloc(nfields * sizeof(field_entry_t));
+    for (n = 0; n < nfields; n++) {
+        fields[n].name = mxGetFieldNameByNumber(data, n);
+        fields[n].field = n;
+    }
+    /* dumpmsgpack.m converts structs into a containers.Map, which
+       stores its keys in sorted order, so the fields are emitted
+       sorted by name to keep the output byte-identical: */
+    qsort(fields, (size_t)nfields, sizeof(field_entry_t), compare_fields);
+    dump_map_header(buf, (size_t)nfields);
+    for (n = 0; n < nfields; n++) {
+        const char *name = fields[n].name;
+        size_t namelen = strlen(name);
+        mxArray *value = mxGetFieldByNumber(data, idx, fields[n].field);
+        dump_str_header(buf, namelen);
+        put_bytes(buf, (const uint8_t*)name, namelen);
+        if (value == NULL)
+            put_byte(buf, 192); /* encode nil */
+        else
+            dump(value, buf);
+    }
+    mxFree(fields);
+}
+
+/* Msgpack can only work with 1D-arrays. An AxBxC array is encoded as
+   nested arrays, so that indexing value(a, b, c) becomes
+   value{a}{b}{c}, just like the num2cell dance in dumpmsgpack.m.
+   Leaves are indexed into the original column-major data. */
+typedef void (*leaf_fn)(const mxArray *data, size_t idx, buffer_t *buf);
+
+static void dump_ndim(const mxArray *data, buffer_t *buf, size_t dim,
+                      size_t offset, const mwSize *dims, size_t ndims,
+                      const size_t *strides, leaf_fn leaf)
+{
+    size_t n;
+    if (dim == ndims) {
+        leaf(data, offset, buf);
+        return;
+    }
+    dump_array_header(buf, dims[dim]);
+    for (n = 0; n < dims[dim]; n++)
+        dump_ndim(data, buf, dim + 1, offset + n * strides[dim],
+                  dims, ndims, strides, leaf);
+}
+
+static void dump_elementwise(const mxArray *data, buffer_t *buf, leaf_fn leaf)
+{
+    size_t numel = mxGetNumberOfElements(data);
+    mwSize ndims = mxGetNumberOfDimensions(data);
+    const mwSize *dims = mxGetDimensions(data);
+    size_t maxdim = 0, n;
+    for (n = 0; n < ndims; n++)
+        if ((size_t)dims[n] > maxdim)
+            maxdim = dims[n];
+    if (maxdim == numel) {
+        /* vectors are encoded as flat arrays */
+        dump_array_header(buf, numel);
+        for (n = 0; n < numel; n++)
+            leaf(data, n, buf);
+    } else {
+        /* matrices are encoded as nested arrays */
+        size_t strides[64];
+        size_t stride = 1;
+        for (n = 0; n < ndims && n < 64; n++) {
+            strides[n] = stride;
+            stride *= dims[n];
+        }
+        dump_ndim(data, buf, 0, 0, dims, ndims, strides, leaf);
+    }
+}
+
+static void dump_cell_leaf(const mxArray *data, size_t idx, buffer_t *buf)
+{
+    mxArray *value = mxGetCell(data, idx);
+    if (value == NULL)
+        put_byte(buf, 192); /* encode nil */
+    else
+        dump(value, buf);
+}
+
+static void dump_map(const mxArray *data, buffer_t *buf)
+{
+    mxArray *keys, *values;
+    size_t len, n;
+    mexCallMATLAB(1, &keys, 1, (mxArray**)&data, "keys");
+    mexCallMATLAB(1, &values, 1, (mxArray**)&data, "values");
+    len = mxGetNumberOfElements(keys);
+    dump_map_header(buf, len);
+    for (n = 0; n < len; n++) {
+        dump(mxGetCell(keys, n), buf);
+        dump(mxGetCell(values, n), buf);
+    }
+    mxDestroyArray(keys);
+    mxDestroyArray(values);
+}
+
+/* check whether a cell array is one of transplant's tagged cells */
+static int is_special_cell(const mxArray *data)
+{
+    static const char *tags[] = {"__matrix__", "__shm_matrix__",
+                                 "__chunked_matrix__", "__striped_matrix__",
+                                 "__sparse__",
+                                 "__sparse_csc__", "__object__",
+                                 "__function__", "__matrix_handle__",
+                                 "__string_array__", "__number_array__",
+                                 "__gpu_matrix__", NULL};
+    const mxArray *tag;
+    char name[32];
+    int n;
+    if (mxGetNumberOfElements(data) == 0)
+        return 0;
+    tag = mxGetCell(data, 0);
+    if (tag == NULL || !mxIsChar(tag))
+        return 0;
+    if (mxGetString(tag, name, sizeof(name)) != 0)
+        return 0;
+    for (n = 0; tags[n] != NULL; n++)
+        if (strcmp(name, tags[n]) == 0)
+            return 1;
+    return 0;
+}
+
+/* encode a tagged cell as an ext value of type 42 that wraps the
+   plain msgpack encoding of the cell */
+static void dump_ext(const mxArray *data, buffer_t *buf)
+{
+    buffer_t payload = {NULL, 0, 0};
+    /* tagged cells nested inside the payload (such as a sparse
+       matrix's index vectors) stay plain msgpack: */
+    use_ext = 0;
+    dump(data, &payload);
+    use_ext = 1;
+    if (payload.len < 256) { /* encode as ext8 */
+        put_byte(buf, 199);
+        put_byte(buf, (uint8_t)payload.len);
+    } else if (payload.len < 65536) { /* encode as ext16 */
+        put_byte(buf, 200);
+        put_be16(buf, (uint16_t)payload.len);
+    } else { /* encode as ext32 */
+        put_byte(buf, 201);
+        put_be32(buf, (uint32_t)payload.len);
+    }
+    put_byte(buf, 42);
+    put_bytes(buf, payload.data, payload.len);
+    mxFree(payload.data);
+}
+
+static int is_vector(const mxArray *data)
+{
+    mwSize ndims = mxGetNumberOfDimensions(data);
+    const mwSize *dims = mxGetDimensions(data);
+    return ndims == 2 && (dims[0] == 1 || dims[1] == 1) &&
+        mxGetNumberOfElements(data) > 0;
+}
+
+static void dump(const mxArray *data, buffer_t *buf)
+{
+    size_t numel = mxGetNumberOfElements(data);
+
+    if ((mxIsNumeric(data) || mxIsLogical(data)) && numel > 1 &&
+        !(is_vector(data) && mxIsUint8(data))) {
+        /* encode numeric matrices as (nested) arrays of numbers */
+        dump_elementwise(data, buf, dump_scalar);
+    } else if (mxIsChar(data) && numel > 0 && !is_vector(data)) {
+        /* encode character matrices as arrays of strings */
+        mxArray *strings;
+        if (mxGetNumberOfDimensions(data) == 2) {
+            mexCallMATLAB(1, &strings, 1, (mxArray**)&data, "cellstr");
+        } else {
+            mexCallMATLAB(1, &strings, 1, (mxArray**)&data, "num2cell");
+        }
+        dump(strings, buf);
+        mxDestroyArray(strings);
+    } else if (mxIsStruct(data)) {
+        if (numel == 1)
+            dump_struct(data, 0, buf);
+        else
+            dump_elementwise(data, buf, dump_struct);
+    } else if (mxIsNumeric(data) && numel == 0) {
+        put_byte(buf, 192); /* encode nil */
+    } else if (mxIsUint8(data) && numel > 1) {
+        dump_bin(data, buf);
+    } else if (mxIsLogical(data)) {
+        put_byte(buf, numel > 0 && *(mxLogical*)mxGetData(data) ? 195 : 194);
+    } else if (mxIsNumeric(data)) {
+        dump_scalar(data, 0, buf);
+    } else if (mxIsChar(data)) {
+        dump_string(data, buf);
+    } else if (mxIsCell(data)) {
+        if (use_ext && is_special_cell(data))
+            dump_ext(data, buf);
+        else
+            dump_elementwise(data, buf, dump_cell_leaf);
+    } else if (mxIsClass(data, "containers.Map")) {
+        dump_map(data, buf);
+    } else {
+        mexErrMsgIdAndTxt("transplant:dumpmsgpack:unknowntype",
+                          "Unknown type \"%s\"", mxGetClassName(data));
+    }
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    buffer_t buf = {NULL, 0, 0};
+    mwSize dims[2];
+    if (nrhs < 1 || nrhs > 2)
+        mexErrMsgIdAndTxt("transplant:dumpmsgpack:argument",
+                          "dumpmsgpack_mex requires one or two arguments");
+    use_ext = nrhs == 2 && mxGetScalar(prhs[1]) != 0;
+    dump(prhs[0], &buf);
+    dims[0] = 1;
+    dims[1] = buf.len;
+    plhs[0] = mxCreateNumericArray(2, dims, mxUINT8_CLASS, mxREAL);
+    memcpy(mxGetData(plhs[0]), buf.data, buf.len);
+    mxFree(buf.data);
+}
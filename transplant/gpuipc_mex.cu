@@ -0,0 +1,49 @@
+/* GPUIPC_MEX exports a gpuArray's device buffer as a CUDA IPC handle
+ *
+ * [HANDLE, DEVICE] = GPUIPC_MEX(VALUE) returns the CUDA IPC memory
+ * handle of the gpuArray VALUE as a uint8 vector, and the zero-based
+ * CUDA device index the buffer lives on. Another process on the same
+ * machine can open the handle and copy the buffer device-to-device,
+ * without staging it through host memory.
+ *
+ * The handle stays valid only as long as the gpuArray is alive, so
+ * the caller has to keep a reference to VALUE until the peer is done
+ * with the buffer (see encode_gpu_matrix in transplant_remote.m).
+ *
+ * Compile this with build_transplant_mex.m, which uses mexcuda;
+ * transplant falls back to gathering into host memory if this file
+ * is not compiled.
+ */
+
+/* This code is licensed under the BSD 3-clause license */
+
+#include <string.h>
+#include "mex.h"
+#include "gpu/mxGPUArray.h"
+#include <cuda_runtime_api.h>
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    mxGPUArray const *array;
+    cudaIpcMemHandle_t handle;
+    cudaError_t err;
+    int device;
+
+    mxInitGPU();
+    if (nrhs != 1 || !mxIsGPUArray(prhs[0]))
+        mexErrMsgIdAndTxt("transplant:gpuipc:argument",
+                          "gpuipc_mex requires exactly one gpuArray argument");
+    array = mxGPUCreateFromMxArray(prhs[0]);
+    err = cudaIpcGetMemHandle(&handle,
+                              (void*)mxGPUGetDataReadOnly(array));
+    mxGPUDestroyGPUArray(array);
+    if (err != cudaSuccess)
+        mexErrMsgIdAndTxt("transplant:gpuipc:export",
+                          "cudaIpcGetMemHandle failed: %s",
+                          cudaGetErrorString(err));
+    cudaGetDevice(&device);
+    plhs[0] = mxCreateNumericMatrix(1, sizeof(handle), mxUINT8_CLASS, mxREAL);
+    memcpy(mxGetData(plhs[0]), &handle, sizeof(handle));
+    if (nlhs > 1)
+        plhs[1] = mxCreateDoubleScalar(device);
+}
@@ -129,8 +129,9 @@ end
 % parses a number and advances idx
 function [obj, idx] = number(json, idx, tokens)
     stop = tokens(idx);
-    obj = str2num(json(idx:stop));
-    if isempty(obj)
+    % sscanf is much faster than str2num, which evals its input:
+    [obj, count, errmsg] = sscanf(json(idx:stop), '%g');
+    if count ~= 1 || ~isempty(errmsg)
         error('JSON:parse:number:nonumber', ...
               ['not a number: "' json(idx:stop) '" (char ' num2str(idx) ')']);
     end
@@ -193,15 +194,23 @@ function [obj, idx] = array(json, idx, tokens)
     idx = idx+1;
     idx = next(json, idx);
     if json(idx) ~= ']'
+        count = 0;
         while 1
             [val, idx] = value(json, idx, tokens);
-            obj(end+1) = {val};
+            count = count+1;
+            if count > numel(obj)
+                % grow the cell array by doubling instead of one
+                % element at a time:
+                obj{max(2*numel(obj), 8)} = [];
+            end
+            obj{count} = val;
             idx = next(json, idx);
             if json(idx) == ','
                 idx = idx+1;
                 idx = next(json, idx);
                 continue
             elseif json(idx) == ']'
+                obj = obj(1:count);
                 break
             else
                 error('JSON:parse:array:unknownseparator', ...
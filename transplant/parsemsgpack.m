@@ -82,7 +82,7 @@ function [obj, idx] = parse(bytes, idx)
             [obj, idx] = parsebytes(len, bytes, idx+5);
         case 199 % ext8
             len = double(bytes(idx+1));
-            [obj, idx] = parseext(len, bytes, idx+1);
+            [obj, idx] = parseext(len, bytes, idx+2);
         case 200 % ext16
             len = double(bytes2scalar(bytes(idx+1:idx+2), 'uint16'));
             [obj, idx] = parseext(len, bytes, idx+3);
@@ -172,8 +172,14 @@ function [out, idx] = parsebytes(len, bytes, idx)
 end
 
 function [out, idx] = parseext(len, bytes, idx)
-    obj.type = bytes(idx);
-    obj.data = bytes(idx+1:idx+len);
+    % ext type 42 wraps the msgpack encoding of one of transplant's
+    % special cell arrays; parse the payload to recover the cell.
+    if bytes(idx) == 42
+        out = parse(bytes, idx+1);
+    else
+        out.type = bytes(idx);
+        out.data = bytes(idx+1:idx+len);
+    end
     idx = idx + len + 1;
 end
 
@@ -0,0 +1,301 @@
+/* PARSEMSGPACK_MEX parses a msgpack byte buffer into Matlab data
+ *
+ * This is a compiled drop-in replacement for parsemsgpack.m. It
+ * produces the same data structures as the pure-Matlab implementation,
+ * but without the byte-at-a-time dispatch overhead of the parse() loop
+ * in parsemsgpack.m. Compile it with build_transplant_mex.m;
+ * transplant falls back to parsemsgpack.m if this file is not
+ * compiled.
+ *
+ * See parsemsgpack.m for the documentation of the decoding rules.
+ */
+
+/* This code is licensed under the BSD 3-clause license */
+
+#include <stdint.h>
+#include <string.h>
+#include "mex.h"
+
+typedef struct {
+    const uint8_t *bytes;
+    size_t len;
+    size_t idx;
+} parser_t;
+
+static void need(parser_t *p, size_t n)
+{
+    if (p->idx + n > p->len)
+        mexErrMsgIdAndTxt("transplant:parsemsgpack:notenoughdata",
+                          "Not enough data in msgpack buffer");
+}
+
+static uint8_t take_byte(parser_t *p)
+{
+    need(p, 1);
+    return p->bytes[p->idx++];
+}
+
+/* msgpack stores all multi-byte values in big-endian byte order */
+static uint16_t take_be16(parser_t *p)
+{
+    uint16_t value;
+    need(p, 2);
+    value = ((uint16_t)p->bytes[p->idx] << 8) | p->bytes[p->idx+1];
+    p->idx += 2;
+    return value;
+}
+
+static uint32_t take_be32(parser_t *p)
+{
+    uint32_t value;
+    need(p, 4);
+    value = ((uint32_t)p->bytes[p->idx] << 24) |
+            ((uint32_t)p->bytes[p->idx+1] << 16) |
+            ((uint32_t)p->bytes[p->idx+2] << 8) |
+            (uint32_t)p->bytes[p->idx+3];
+    p->idx += 4;
+    return value;
+}
+
+static uint64_t take_be64(parser_t *p)
+{
+    uint64_t value = 0;
+    int n;
+    need(p, 8);
+    for (n = 0; n < 8; n++)
+        value = (value << 8) | p->bytes[p->idx+n];
+    p->idx += 8;
+    return value;
+}
+
+static mxArray *scalar(mxClassID class_id, const void *value, size_t size)
+{
+    mxArray *out = mxCreateNumericMatrix(1, 1, class_id, mxREAL);
+    memcpy(mxGetData(out), value, size);
+    return out;
+}
+
+static mxArray *parse(parser_t *p);
+
+static mxArray *parse_string(parser_t *p, size_t len)
+{
+    mxArray *out;
+    size_t n;
+    int is_ascii = 1;
+    need(p, len);
+    for (n = 0; n < len; n++) {
+        if (p->bytes[p->idx+n] > 127) {
+            is_ascii = 0;
+            break;
+        }
+    }
+    if (is_ascii) {
+        mwSize dims[2] = {1, (mwSize)len};
+        mxChar *chars;
+        out = mxCreateCharArray(2, dims);
+        chars = (mxChar*)mxGetData(out);
+        for (n = 0; n < len; n++)
+            chars[n] = p->bytes[p->idx+n];
+    } else {
+        /* non-ASCII strings go through Matlab's UTF-8 decoder */
+        mxArray *argin[2];
+        argin[0] = mxCreateNumericMatrix(1, len, mxUINT8_CLASS, mxREAL);
+        memcpy(mxGetData(argin[0]), p->bytes + p->idx, len);
+        argin[1] = mxCreateString("utf-8");
+        mexCallMATLAB(1, &out, 2, argin, "native2unicode");
+        mxDestroyArray(argin[0]);
+        mxDestroyArray(argin[1]);
+    }
+    p->idx += len;
+    return out;
+}
+
+static mxArray *parse_bytes(parser_t *p, size_t len)
+{
+    mxArray *out;
+    need(p, len);
+    out = mxCreateNumericMatrix(len, 1, mxUINT8_CLASS, mxREAL);
+    memcpy(mxGetData(out), p->bytes + p->idx, len);
+    p->idx += len;
+    return out;
+}
+
+static mxArray *parse_ext(parser_t *p, size_t len)
+{
+    const char *fields[2] = {"type", "data"};
+    mxArray *out;
+    uint8_t type = take_byte(p);
+    if (type == 42) {
+        /* transplant's tagged cells travel as ext type 42, wrapping
+           their plain msgpack encoding (see dumpmsgpack.m); unwrap
+           them in place: */
+        return parse(p);
+    }
+    out = mxCreateStructMatrix(1, 1, 2, fields);
+    mxSetField(out, 0, "type", scalar(mxUINT8_CLASS, &type, 1));
+    mxSetField(out, 0, "data", parse_bytes(p, len));
+    return out;
+}
+
+static mxArray *parse_array(parser_t *p, size_t len)
+{
+    mxArray *out = mxCreateCellMatrix(1, len);
+    size_t n;
+    for (n = 0; n < len; n++)
+        mxSetCell(out, n, parse(p));
+    return out;
+}
+
+static mxArray *parse_map(parser_t *p, size_t len)
+{
+    mxArray *out;
+    if (len == 0) {
+        mexCallMATLAB(1, &out, 0, NULL, "containers.Map");
+    } else {
+        mxArray *argin[4];
+        size_t n;
+        argin[0] = mxCreateCellMatrix(1, len);
+        argin[1] = mxCreateCellMatrix(1, len);
+        for (n = 0; n < len; n++) {
+            mxSetCell(argin[0], n, parse(p));
+            mxSetCell(argin[1], n, parse(p));
+        }
+        argin[2] = mxCreateString("UniformValues");
+        argin[3] = mxCreateLogicalScalar(false);
+        mexCallMATLAB(1, &out, 4, argin, "containers.Map");
+        mxDestroyArray(argin[0]);
+        mxDestroyArray(argin[1]);
+        mxDestroyArray(argin[2]);
+        mxDestroyArray(argin[3]);
+    }
+    return out;
+}
+
+static mxArray *parse(parser_t *p)
+{
+    uint8_t currentbyte = take_byte(p);
+
+    if ((currentbyte & 0x80) == 0) {
+        /* decode positive fixint */
+        int8_t value = (int8_t)currentbyte;
+        return scalar(mxINT8_CLASS, &value, 1);
+    } else if ((currentbyte & 0xe0) == 0xe0) {
+        /* decode negative fixint */
+        int8_t value = (int8_t)currentbyte;
+        return scalar(mxINT8_CLASS, &value, 1);
+    } else if ((currentbyte & 0xf0) == 0x80) {
+        /* decode fixmap */
+        return parse_map(p, currentbyte & 0x0f);
+    } else if ((currentbyte & 0xf0) == 0x90) {
+        /* decode fixarray */
+        return parse_array(p, currentbyte & 0x0f);
+    } else if ((currentbyte & 0xe0) == 0xa0) {
+        /* decode fixstr */
+        return parse_string(p, currentbyte & 0x1f);
+    }
+
+    switch (currentbyte) {
+    case 192: /* nil */
+        return mxCreateDoubleMatrix(0, 0, mxREAL);
+    case 194: /* false */
+        return mxCreateLogicalScalar(false);
+    case 195: /* true */
+        return mxCreateLogicalScalar(true);
+    case 196: /* bin8 */
+        return parse_bytes(p, take_byte(p));
+    case 197: /* bin16 */
+        return parse_bytes(p, take_be16(p));
+    case 198: /* bin32 */
+        return parse_bytes(p, take_be32(p));
+    case 199: /* ext8 */
+        return parse_ext(p, take_byte(p));
+    case 200: /* ext16 */
+        return parse_ext(p, take_be16(p));
+    case 201: /* ext32 */
+        return parse_ext(p, take_be32(p));
+    case 202: { /* float32 */
+        uint32_t bits = take_be32(p);
+        float value;
+        memcpy(&value, &bits, 4);
+        return scalar(mxSINGLE_CLASS, &value, 4);
+    }
+    case 203: { /* float64 */
+        uint64_t bits = take_be64(p);
+        double value;
+        memcpy(&value, &bits, 8);
+        return scalar(mxDOUBLE_CLASS, &value, 8);
+    }
+    case 204: { /* uint8 */
+        uint8_t value = take_byte(p);
+        return scalar(mxUINT8_CLASS, &value, 1);
+    }
+    case 205: { /* uint16 */
+        uint16_t value = take_be16(p);
+        return scalar(mxUINT16_CLASS, &value, 2);
+    }
+    case 206: { /* uint32 */
+        uint32_t value = take_be32(p);
+        return scalar(mxUINT32_CLASS, &value, 4);
+    }
+    case 207: { /* uint64 */
+        uint64_t value = take_be64(p);
+        return scalar(mxUINT64_CLASS, &value, 8);
+    }
+    case 208: { /* int8 */
+        int8_t value = (int8_t)take_byte(p);
+        return scalar(mxINT8_CLASS, &value, 1);
+    }
+    case 209: { /* int16 */
+        int16_t value = (int16_t)take_be16(p);
+        return scalar(mxINT16_CLASS, &value, 2);
+    }
+    case 210: { /* int32 */
+        int32_t value = (int32_t)take_be32(p);
+        return scalar(mxINT32_CLASS, &value, 4);
+    }
+    case 211: { /* int64 */
+        int64_t value = (int64_t)take_be64(p);
+        return scalar(mxINT64_CLASS, &value, 8);
+    }
+    case 212: /* fixext1 */
+        return parse_ext(p, 1);
+    case 213: /* fixext2 */
+        return parse_ext(p, 2);
+    case 214: /* fixext4 */
+        return parse_ext(p, 4);
+    case 215: /* fixext8 */
+        return parse_ext(p, 8);
+    case 216: /* fixext16 */
+        return parse_ext(p, 16);
+    case 217: /* str8 */
+        return parse_string(p, take_byte(p));
+    case 218: /* str16 */
+        return parse_string(p, take_be16(p));
+    case 219: /* str32 */
+        return parse_string(p, take_be32(p));
+    case 220: /* array16 */
+        return parse_array(p, take_be16(p));
+    case 221: /* array32 */
+        return parse_array(p, take_be32(p));
+    case 222: /* map16 */
+        return parse_map(p, take_be16(p));
+    case 223: /* map32 */
+        return parse_map(p, take_be32(p));
+    default:
+        mexErrMsgIdAndTxt("transplant:parsemsgpack:unknowntype",
+                          "Unknown type \"%d\"", (int)currentbyte);
+        return NULL; /* not reached */
+    }
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    parser_t p;
+    if (nrhs != 1 || !mxIsUint8(prhs[0]))
+        mexErrMsgIdAndTxt("transplant:parsemsgpack:argument",
+                          "parsemsgpack_mex requires a uint8 array");
+    p.bytes = (const uint8_t*)mxGetData(prhs[0]);
+    p.len = mxGetNumberOfElements(prhs[0]);
+    p.idx = 0;
+    plhs[0] = parse(&p);
+}
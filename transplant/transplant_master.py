@@ -3,13 +3,22 @@ from signal import SIGINT
 import sys
 import re
 import os
+import shutil
 import tempfile
 from glob import glob
 import zmq
 import numpy as np
 import base64
-from threading import Thread
+from threading import Thread, Lock
+from time import perf_counter
+import math
+from concurrent.futures import Future, ThreadPoolExecutor
+from collections import deque
+from queue import Queue, Empty
+import json
 import msgpack
+import zlib
+import warnings
 import ctypes.util
 
 try:
@@ -20,6 +29,13 @@ except ImportError:
     # installed:
     sparse_matrix = tuple()
 
+try:
+    # optional compiled accelerator for the recursive encode/decode
+    # walks; built by setup.py if a compiler is available:
+    from . import _fastwalk
+except ImportError:
+    _fastwalk = None
+
 
 """Transplant is a Python client for remote code execution
 
@@ -35,14 +51,21 @@ It can start and connect Matlab servers and send them messages. All
 messages are JSON-encoded strings. All messages are dictionaries with
 at least one key: 'type'.
 
-Depending on the message type, other keys may or may not be set.
+Depending on the message type, other keys may or may not be set. Any
+request may additionally carry a list of proxy handles 'free_proxies'
+that the server should release.
 
-There are seven request types sent by Python:
+There are ten request types sent by Python:
 - 'die': the server closes its 0MQ session and quits.
 - 'set_global': saves the 'value' as a global variable called 'name'.
 - 'get_global': retrieves the value of a global variable 'name'.
 - 'del_proxy': remove cached object 'handle'.
 - 'call': call function 'name' with 'args' and 'nargout'.
+- 'call_batch': execute a list of 'calls' in one round trip.
+- 'set_option': set transfer option 'name' to 'value'.
+- 'fetch_matrix': fetch 'slices' of a matrix held by 'handle'.
+- 'get_attr': read property 'name' of the object at 'handle'.
+- 'set_attr': write 'value' to property 'name' of the object at 'handle'.
 
 There are three response types:
 - 'ack': the server received the message successfully.
@@ -58,6 +81,11 @@ encoded specially when transmitted between Python and Matlab:
 """
 
 
+# frame size for chunked matrix streaming (see `Matlab.__init__`'s
+# `chunk_threshold`):
+CHUNK_SIZE = 2**24
+
+
 class TransplantError(RuntimeError):
     """An exception that retains some Remote-specific metadata."""
 
@@ -80,6 +108,34 @@ class TransplantMaster:
 
     ProxyObject = None
 
+    # shared-memory matrix transfer is disabled until negotiated:
+    _shm_dir = None
+    _shm_threshold = None
+    # chunked matrix streaming is disabled until negotiated:
+    _chunk_threshold = None
+    # striped multi-socket transfers are disabled until negotiated:
+    _stripe_sockets = None
+    _stripe_threshold = None
+    # matrix payload compression is disabled until negotiated:
+    _compress_threshold = None
+    # order-preserving matrix transfers are disabled until negotiated:
+    _matrix_order = False
+    # ext-tagged special values are disabled until negotiated:
+    _msgpack_ext = False
+    # raw CSC sparse matrix transfers are disabled until negotiated:
+    _sparse_csc = False
+    # the PUB/SUB output channel is disabled until negotiated:
+    _pubsocket = None
+    # timing instrumentation is disabled until enabled:
+    _stats = None
+    _stats_lock = None
+    # set when the I/O thread exits, so senders fail fast instead of
+    # enqueueing messages nothing will ever answer:
+    _ioloop_error = None
+    # set when the launcher process died but the remote itself is
+    # known to live on (see Matlab.reconnect):
+    _detached = False
+
     def __init__(self, address):
         pass
 
@@ -97,7 +153,15 @@ class TransplantMaster:
         # ignore if remote already shut down:
         if self.socket.closed:
             return
-        self.send_message('del_proxy', handle=handle)
+        # deletions are queued, and ride along on the next outgoing
+        # message as 'free_proxies'. Garbage collection may run on any
+        # thread, even in the middle of an encode, so this must not
+        # take a lock; list.append is atomic.
+        self._dead_proxies.append(handle)
+
+    def _set_option(self, name, value):
+        """Negotiate a transfer option with the remote."""
+        self.send_message('set_option', name=name, value=value)
 
     def __getattr__(self, name):
         """Retrieve a value or function from the remote."""
@@ -105,7 +169,17 @@ class TransplantMaster:
 
     def __setattr__(self, name, value):
         """Retrieve a value or function from the remote."""
-        if name in ['ipcfile', 'context', 'socket', 'process', 'msgformat']:
+        if name in ['ipcfile', 'context', 'socket', 'process', 'msgformat',
+                    '_encode_lock', '_outgoing_chunks', '_incoming_chunks',
+                    '_outbox', '_iothread', '_shm_dir', '_shm_threshold',
+                    '_chunk_threshold', '_compress_threshold',
+                    '_stats', '_stats_lock', '_proxy_classes',
+                    '_matrix_order', '_msgpack_ext', '_nargout_cache',
+                    '_dead_proxies', '_pubsocket', '_sparse_csc',
+                    '_ssh_address', '_ssh_options', '_ssh_forwards',
+                    '_stripe_sockets', '_stripe_threshold',
+                    '_outgoing_stripes', '_incoming_stripes',
+                    '_stripes_read', '_ioloop_error', '_detached']:
             self.__dict__[name] = value
         else:
             self._set_global(name, value)
@@ -127,6 +201,32 @@ class TransplantMaster:
                 print(line.decode(), end='')
         Thread(target=reader, daemon=True).start()
 
+    def _start_pub_reader(self, pub_address):
+        """Starts an asynchronous reader for the remote's PUB channel.
+
+        The remote publishes output captured during function calls on
+        this channel. Both ends keep a bounded queue, so heavy output
+        is dropped under load instead of back-pressuring the remote.
+        """
+        socket = self.context.socket(zmq.SUB)
+        socket.setsockopt(zmq.SUBSCRIBE, b'')
+        socket.setsockopt(zmq.RCVHWM, 100)
+        socket.bind(pub_address)
+        self._pubsocket = socket
+        def reader():
+            """Echo what the remote publishes using print"""
+            while True:
+                try:
+                    data = socket.recv()
+                except zmq.ZMQError:
+                    # terminating the context on exit unblocks the
+                    # receive; close the socket so the termination
+                    # can complete:
+                    socket.close(linger=0)
+                    break
+                print(data.decode(errors='replace'), end='')
+        Thread(target=reader, daemon=True).start()
+
     def __enter__(self):
         return self
 
@@ -135,10 +235,22 @@ class TransplantMaster:
 
     def exit(self):
         """Close the connection, and kill the process."""
-        if self.process.returncode is not None:
+        if self.process.returncode is not None and not self._detached:
+            # a detached instance outlives its launcher process, so
+            # its death says nothing about the remote (see
+            # Matlab.reconnect):
+            return
+        if self._ioloop_error is not None:
+            # nothing can be sent any more; just take the process
+            # down. A detached remote is unreachable by signals, too,
+            # so there is nothing left to do for it:
+            if not self._detached:
+                self.process.terminate()
+                self.process.wait()
             return
         self.send_message('die')
-        self.process.wait()
+        if not self._detached:
+            self.process.wait()
 
     def __del__(self):
         """Close the connection, and kill the process."""
@@ -146,44 +258,225 @@ class TransplantMaster:
 
     def send_message(self, msg_type, **kwargs):
         """Send a message and return the response"""
-        kwargs = self._encode_values(kwargs)
+        return self.send_message_async(msg_type, **kwargs).result()
 
-        self._wait_socket(zmq.POLLOUT)
-        if self.msgformat == 'msgpack':
-            self.socket.send(msgpack.packb(dict(kwargs, type=msg_type), use_bin_type=True), flags=zmq.NOBLOCK)
-        else:
-            self.socket.send_json(dict(kwargs, type=msg_type), flags=zmq.NOBLOCK)
+    def send_message_async(self, msg_type, **kwargs):
+        """Send a message and return a Future for the response.
+
+        The remote executes messages strictly in order, so several
+        messages can be in flight at the same time. Responses are
+        matched to their requests first-in-first-out by the I/O
+        thread.
 
-        self._wait_socket(zmq.POLLIN)
+        """
+        if self._ioloop_error is not None:
+            # the I/O thread is gone; a queued message would never be
+            # sent, and its future would never resolve:
+            raise RuntimeError('Connection to the remote is dead') \
+                from self._ioloop_error
+        timed = self._stats is not None
+        if timed:
+            encode_start = perf_counter()
+        if self._dead_proxies:
+            # proxy deletions queued by garbage collection ride along
+            # on this message. Garbage collection may append at any
+            # time, so send a counted snapshot and drop exactly those
+            # entries afterwards; appends that race with this message
+            # stay queued for the next one:
+            ndead = len(self._dead_proxies)
+            kwargs['free_proxies'] = self._dead_proxies[:ndead]
+            del self._dead_proxies[:ndead]
+        with self._encode_lock:
+            kwargs = self._encode_values(kwargs)
+            # chunked matrices ride along as additional frames:
+            chunks, self._outgoing_chunks = self._outgoing_chunks, []
+            # striped matrices go out on the parallel data sockets:
+            stripes, self._outgoing_stripes = self._outgoing_stripes, []
         if self.msgformat == 'msgpack':
-            response = msgpack.unpackb(self.socket.recv(flags=zmq.NOBLOCK), raw=False, max_bin_len=2**31-1)
+            payload = msgpack.packb(dict(kwargs, type=msg_type), use_bin_type=True)
         else:
-            response = self.socket.recv_json(flags=zmq.NOBLOCK)
-
-        response = self._decode_values(response)
-        if response['type'] == 'error':
-            # Create a pretty backtrace almost like Python's:
-            trace = 'Traceback (most recent call last):\n'
-            if isinstance(response['stack'], dict):
-                response['stack'] = [response['stack']]
-            for frame in reversed(response['stack']):
-                trace += '  File "{file}", line {line:.0f}, in {name}\n'.format(**frame)
-                if frame['file'] is not None and os.path.exists(frame['file']) and frame['file'].endswith('.m'):
-                    trace += '    ' + open(frame['file'], 'r', errors='replace').readlines()[int(frame['line'])-1].strip(' ')
-            raise TransplantError('{message} ({identifier})\n'.format(**response) + trace,
-                              response['stack'], response['identifier'], response['message'])
-        return response
-
-    def _wait_socket(self, flags, timeout=1000):
-        """Wait for socket or crashed process."""
+            payload = json.dumps(dict(kwargs, type=msg_type)).encode()
+        future = Future()
+        if timed:
+            self._record_phase('encode', perf_counter() - encode_start)
+            with self._stats_lock:
+                self._stats['messages'] += 1
+                self._stats['bytes_sent'] += (
+                    len(payload) + sum(len(c) for c in chunks) +
+                    sum(len(b) for blocks in stripes for b in blocks))
+            # measure the round trip from here, since the actual
+            # socket send happens on the I/O thread:
+            future.sent_at = perf_counter()
+        self._outbox.put(([payload] + chunks, stripes, future))
+        return future
+
+    def _record_phase(self, phase, seconds):
+        """Add one duration to the timing statistics of a phase.
+
+        Durations are binned into power-of-two histogram buckets: a
+        count at key `e` means a duration between `2**(e-1)` and
+        `2**e` seconds.
+
+        """
+        with self._stats_lock:
+            stats = self._stats['phases'].setdefault(
+                phase, dict(total=0.0, max=0.0, histogram={}))
+            stats['total'] += seconds
+            if seconds > stats['max']:
+                stats['max'] = seconds
+            bucket = math.frexp(seconds)[1]
+            stats['histogram'][bucket] = stats['histogram'].get(bucket, 0) + 1
+
+    def _start_ioloop(self):
+        """Start the thread that owns the ZMQ socket.
+
+        ZMQ sockets must only ever be used from one thread, so all
+        socket traffic goes through this thread, fed by the `_outbox`
+        queue.
+
+        """
+        self._outbox = Queue()
+        self._encode_lock = Lock()
+        self._outgoing_chunks = []
+        self._outgoing_stripes = []
+        self._dead_proxies = []
+        self._incoming_chunks = []
+        # stripe sets read ahead of the decode walk, keyed by their
+        # sequence number (see _decode_striped_matrix):
+        self._incoming_stripes = {}
+        self._stripes_read = 0
+        self._iothread = Thread(target=self._ioloop, daemon=True)
+        self._iothread.start()
+
+    def _ioloop(self):
+        """Forward queued requests to the socket and resolve futures.
+
+        The remote answers requests in order, so the oldest
+        outstanding future always belongs to the next response.
+
+        """
+        pending = deque()
+        while True:
+            try:
+                # forward queued requests to the socket:
+                try:
+                    frames, stripes, future = \
+                        self._outbox.get(block=(not pending), timeout=0.1)
+                    if frames is None: # sentinel from exit()
+                        break
+                    # zero-copy frames save another full-payload copy,
+                    # but their bookkeeping only pays off for large
+                    # messages:
+                    copy = sum(len(frame) for frame in frames) < 2**16
+                    self.socket.send_multipart([b''] + frames, copy=copy)
+                    # striped matrix payloads go out on the parallel
+                    # data sockets, one block per socket. The sends
+                    # only queue the blocks; libzmq's I/O threads push
+                    # them onto the wire concurrently:
+                    for blocks in stripes:
+                        for socket, block in zip(self._stripe_sockets,
+                                                 blocks):
+                            socket.send(block, copy=False)
+                    pending.append(future)
+                except Empty:
+                    pass
+                # resolve outstanding futures with received responses:
+                while pending and self.socket.poll(100, zmq.POLLIN) != 0:
+                    # received frames are handed on as views into the
+                    # zmq message buffers instead of bytes copies:
+                    frames = self.socket.recv_multipart(flags=zmq.NOBLOCK,
+                                                        copy=False)
+                    if frames and len(frames[0]) == 0: # strip REP envelope
+                        frames = frames[1:]
+                    self._resolve(pending.popleft(), frames[0].buffer,
+                                  [frame.buffer for frame in frames[1:]])
+                if (pending and not self._detached and
+                        self.process.poll() is not None):
+                    raise RuntimeError('Process died unexpectedly')
+            except Exception as exc:
+                # mark the loop as dead before failing the futures, so
+                # senders fail fast from now on:
+                self._ioloop_error = exc
+                while pending:
+                    pending.popleft().set_exception(exc)
+                break
+        # unblock anyone waiting for an answer that will never come:
+        error = RuntimeError('Connection was closed')
+        if self._ioloop_error is None:
+            self._ioloop_error = error
         while True:
-            if self.process.poll() is not None:
-                raise RuntimeError('Process died unexpectedly')
-            if self.socket.poll(timeout, flags) != 0:
-                return
+            try:
+                payload, stripes, future = self._outbox.get_nowait()
+                if future is not None:
+                    future.set_exception(error)
+            except Empty:
+                break
+
+    def _resolve(self, future, raw, chunks=()):
+        """Decode a raw response and fulfill its request's future."""
+        try:
+            timed = self._stats is not None
+            if timed:
+                decode_start = perf_counter()
+            self._incoming_chunks = list(chunks)
+            self._incoming_stripes = {}
+            self._stripes_read = 0
+            if self.msgformat == 'msgpack':
+                response = msgpack.unpackb(raw, raw=False, max_bin_len=2**31-1,
+                                           ext_hook=self._decode_ext)
+            else:
+                response = json.loads(bytes(raw).decode())
+            if not self._msgpack_ext:
+                # without ext-tagged special values, the whole decoded
+                # tree has to be searched for them:
+                response = self._decode_values(response)
+            if timed:
+                now = perf_counter()
+                self._record_phase('decode', now - decode_start)
+                if hasattr(future, 'sent_at'):
+                    self._record_phase('roundtrip', now - future.sent_at)
+                with self._stats_lock:
+                    self._stats['bytes_received'] += (len(raw) +
+                                                      sum(len(c) for c in chunks))
+            if timed and isinstance(response, dict) and 'timings' in response:
+                # the remote piggybacks its own phase timings on the
+                # response when the 'timing' option is set:
+                for phase, seconds in response.pop('timings').items():
+                    if phase != 'execute':
+                        phase = 'remote_' + phase
+                    self._record_phase(phase, seconds)
+            if response['type'] == 'error':
+                future.set_exception(self._make_error(response))
+            else:
+                future.set_result(response)
+        except Exception as exc:
+            future.set_exception(exc)
+
+    def _make_error(self, response):
+        """Create a TransplantError with a pretty backtrace almost like
+        Python's from an error response."""
+        trace = 'Traceback (most recent call last):\n'
+        if isinstance(response['stack'], dict):
+            response['stack'] = [response['stack']]
+        for frame in reversed(response['stack']):
+            trace += '  File "{file}", line {line:.0f}, in {name}\n'.format(**frame)
+            if frame['file'] is not None and os.path.exists(frame['file']) and frame['file'].endswith('.m'):
+                trace += '    ' + open(frame['file'], 'r', errors='replace').readlines()[int(frame['line'])-1].strip(' ')
+        return TransplantError('{message} ({identifier})\n'.format(**response) + trace,
+                               response['stack'], response['identifier'], response['message'])
 
     def _encode_values(self, data):
         """Recursively walk through data and encode special entries."""
+        if _fastwalk is not None:
+            return _fastwalk.encode_values(self, data)
+        return self._encode_values_py(data)
+
+    def _encode_values_py(self, data):
+        """Pure-Python implementation of the encode walk.
+
+        The compiled walker handles plain containers and scalars
+        itself, and calls back into this for the special entries.
+        """
         if isinstance(data, (np.ndarray, np.number)):
             return self._encode_matrix(data)
         elif isinstance(data, complex):
@@ -195,6 +488,9 @@ class TransplantMaster:
             return self._encode_sparse_matrix(data)
         elif isinstance(data, self.ProxyObject):
             return self._encode_proxy(data)
+        elif isinstance(data, MatlabMatrixHandle):
+            return ["__matrix_handle__", data.dtype,
+                    list(data.shape), data.handle]
         elif isinstance(data, MatlabStruct):
             out = ["__struct__", {}]
             for key in data:
@@ -215,14 +511,56 @@ class TransplantMaster:
 
     def _decode_values(self, data):
         """Recursively walk through data and decode special entries."""
+        if _fastwalk is not None:
+            return _fastwalk.decode_values(self, data)
+        return self._decode_values_py(data)
+
+    def _decode_values_py(self, data):
+        """Pure-Python implementation of the decode walk.
+
+        The compiled walker handles plain containers itself, and
+        calls back into this for the tagged special lists.
+        """
         if (isinstance(data, list) and
-            len(data) == 4 and
+            len(data) in (4, 5) and
             data[0] == "__matrix__"):
             return self._decode_matrix(data)
+        elif (isinstance(data, list) and
+            len(data) in (4, 5) and
+            data[0] == "__shm_matrix__"):
+            return self._decode_shm_matrix(data)
+        elif (isinstance(data, list) and
+            len(data) in (4, 5) and
+            data[0] == "__chunked_matrix__"):
+            return self._decode_chunked_matrix(data)
+        elif (isinstance(data, list) and
+            len(data) in (4, 5) and
+            data[0] == "__striped_matrix__"):
+            return self._decode_striped_matrix(data)
+        elif (isinstance(data, list) and
+            len(data) == 4 and
+            data[0] == "__matrix_handle__"):
+            return MatlabMatrixHandle(self, *data[1:])
         elif (isinstance(data, list) and
             len(data) == 5 and
             data[0] == "__sparse__"):
             return self._decode_sparse_matrix(data)
+        elif (isinstance(data, list) and
+            len(data) == 5 and
+            data[0] == "__sparse_csc__"):
+            return self._decode_sparse_csc_matrix(data)
+        elif (isinstance(data, list) and
+            len(data) == 6 and
+            data[0] == "__gpu_matrix__"):
+            return self._decode_gpu_matrix(data)
+        elif (isinstance(data, list) and
+            len(data) == 3 and
+            data[0] == "__string_array__"):
+            return self._decode_string_array(data)
+        elif (isinstance(data, list) and
+            len(data) == 2 and
+            data[0] == "__number_array__"):
+            return self._decode_matrix(data[1]).ravel()
         elif (isinstance(data, list) and
             len(data) == 2 and
             data[0] == "__object__"):
@@ -243,6 +581,19 @@ class TransplantMaster:
             out = data
         return out
 
+    def _decode_ext(self, code, data):
+        """Decode a msgpack ext value.
+
+        Ext type 42 wraps the plain msgpack encoding of one of the
+        special list values, so that the unpacker itself recognizes
+        them and `_resolve` can skip the recursive walk over the
+        decoded tree.
+        """
+        if code != 42:
+            return msgpack.ExtType(code, data)
+        value = msgpack.unpackb(data, raw=False, max_bin_len=2**31-1)
+        return self._decode_values(value)
+
     def _encode_matrix(self, data):
         """Encode a Numpy array as a special list.
 
@@ -254,14 +605,167 @@ class TransplantMaster:
         and `"AQAAAAIAAAADAAAABAAAA==\n"` is the base64-encoded matrix
         content.
 
+        If the 'matrix_order' option is negotiated, Fortran-ordered
+        arrays are sent as their native bytes with an additional
+        `"F"` element instead of being copied into C order first.
+
         """
 
+        if (self._matrix_order and data.ndim > 1 and
+                data.flags.f_contiguous and not data.flags.c_contiguous):
+            # data.T is a C-contiguous view whose bytes are the
+            # Fortran-order bytes of data, so the reordering copy a
+            # plain .tobytes() would make is avoided:
+            data, order = data.T, ["F"]
+            shape = data.shape[::-1]
+        else:
+            order = []
+            shape = data.shape
+        if self._shm_dir is not None and data.nbytes > self._shm_threshold:
+            # large matrices are passed through a shared memory-mapped
+            # file instead of the message itself:
+            fd, filename = tempfile.mkstemp(dir=self._shm_dir)
+            with os.fdopen(fd, 'wb') as f:
+                # write the array buffer directly, without the full
+                # copy a .tobytes() would make:
+                f.write(memoryview(np.ascontiguousarray(data)).cast('B'))
+            return ["__shm_matrix__", data.dtype.name, shape,
+                    filename] + order
+        if (self._stripe_sockets is not None and
+                data.nbytes > self._stripe_threshold):
+            # stripe the matrix content across the parallel data
+            # sockets, one contiguous block per socket, so several
+            # TCP streams carry it concurrently:
+            data = np.ascontiguousarray(data)
+            buffer = memoryview(data).cast('B')
+            blocksize = -(-len(buffer) // len(self._stripe_sockets))
+            # the record names its stripe set by sequence number,
+            # since the decode walk on the other side may visit the
+            # records in a different order than the encode walk sent
+            # them (containers.Map iterates its keys in sorted order):
+            seq = len(self._outgoing_stripes)
+            self._outgoing_stripes.append(
+                [buffer[n*blocksize:(n+1)*blocksize]
+                 for n in range(len(self._stripe_sockets))])
+            return ["__striped_matrix__", data.dtype.name, shape,
+                    [seq, len(buffer)]] + order
+        if (self._chunk_threshold is not None and
+                self.msgformat == 'msgpack' and
+                data.nbytes > self._chunk_threshold):
+            # stream the matrix content as fixed-size message frames
+            # instead of embedding it in the msgpack blob:
+            data = np.ascontiguousarray(data)
+            buffer = memoryview(data).cast('B')
+            nchunks = -(-len(buffer) // CHUNK_SIZE)
+            # the record names its frames by index, since the decode
+            # walk on the other side may visit the records in a
+            # different order than the encode walk appended them
+            # (containers.Map iterates its keys in sorted order):
+            first = len(self._outgoing_chunks)
+            for n in range(nchunks):
+                self._outgoing_chunks.append(
+                    buffer[n*CHUNK_SIZE:(n+1)*CHUNK_SIZE])
+            return ["__chunked_matrix__", data.dtype.name, shape,
+                    [first, nchunks]] + order
         if self.msgformat == 'json':
-            return ["__matrix__", data.dtype.name, data.shape,
-                    base64.b64encode(data.tostring()).decode()]
+            # b64encode reads the array buffer directly, without the
+            # full copy a .tobytes() would make:
+            return ["__matrix__", data.dtype.name, shape,
+                    base64.b64encode(np.ascontiguousarray(data).data)
+                          .decode()] + order
         else:
-            return ["__matrix__", data.dtype.name, data.shape,
-                    data.tobytes()]
+            # a C-contiguous view lets the packer read the array
+            # buffer directly, without the full copy a .tobytes()
+            # would make:
+            binary = memoryview(np.ascontiguousarray(data)).cast('B')
+            if (self._compress_threshold is not None and
+                    len(binary) > self._compress_threshold):
+                # zlib at level 1 is fast enough to pay off whenever
+                # the wire is the bottleneck:
+                compressed = zlib.compress(binary, 1)
+                # skip incompressible data, where decompression would
+                # only add latency:
+                if len(compressed) < 0.9 * len(binary):
+                    binary = ["__compressed__", "zlib",
+                              len(binary), compressed]
+            return ["__matrix__", data.dtype.name, shape, binary] + order
+
+    def _decode_chunked_matrix(self, data):
+        """Decode a special list to a Numpy array.
+
+        The matrix content of a
+        `["__chunked_matrix__", "int32", [2, 2], [0, 3]]`
+        arrives in 3 additional message frames starting at frame 0
+        instead of inline bytes. The frames are named by index, so the
+        record decodes correctly no matter in which order the decode
+        walk visits it. They are copied directly into the destination
+        array, so peak memory stays bounded by the frame size.
+
+        """
+
+        dtype, shape = data[1:3]
+        first, nchunks = (int(n) for n in data[3])
+        order = data[4] if len(data) == 5 else 'C'
+        shape = [int(n) for n in shape]
+        flat = np.empty(int(np.prod(shape)) * np.dtype(dtype).itemsize,
+                        np.uint8)
+        offset = 0
+        for raw in self._incoming_chunks[first:first+nchunks]:
+            chunk = np.frombuffer(raw, np.uint8)
+            flat[offset:offset+len(chunk)] = chunk
+            offset += len(chunk)
+        return flat.view(dtype).reshape(shape, order=order)
+
+    def _decode_striped_matrix(self, data):
+        """Decode a special list to a Numpy array.
+
+        The matrix content of a
+        `["__striped_matrix__", "int32", [2, 2], [0, 16]]`
+        arrives as one contiguous block per parallel data socket
+        instead of inline bytes, where `0` is the record's sequence
+        number and `16` the total number of payload bytes. The sockets
+        deliver the stripe sets in the order they were sent, which may
+        differ from the order in which the decode walk visits the
+        records, so sets are read forward and stashed until the wanted
+        sequence number arrives. The blocks are copied directly into
+        the destination array. This runs on the I/O thread, which owns
+        the stripe sockets.
+
+        """
+
+        dtype, shape = data[1:3]
+        seq, nbytes = (int(n) for n in data[3])
+        order = data[4] if len(data) == 5 else 'C'
+        shape = [int(n) for n in shape]
+        while seq not in self._incoming_stripes:
+            self._incoming_stripes[self._stripes_read] = [
+                socket.recv(copy=False) for socket in self._stripe_sockets]
+            self._stripes_read += 1
+        blocks = self._incoming_stripes.pop(seq)
+        flat = np.empty(int(nbytes), np.uint8)
+        offset = 0
+        for raw in blocks:
+            block = np.frombuffer(raw.buffer, np.uint8)
+            flat[offset:offset+len(block)] = block
+            offset += len(block)
+        return flat.view(dtype).reshape(shape, order=order)
+
+    def _decode_shm_matrix(self, data):
+        """Decode a special list to a Numpy array.
+
+        The matrix content of a
+        `["__shm_matrix__", "int32", [2, 2], "/tmp/transplant-x/segment"]`
+        lives in a shared memory-mapped file instead of the message.
+        The file is deleted after reading.
+
+        """
+
+        dtype, shape, filename = data[1:4]
+        order = data[4] if len(data) == 5 else 'C'
+        out = np.fromfile(filename, dtype)
+        os.remove(filename)
+        shape = [int(n) for n in shape]
+        return out.reshape(shape, order=order)
 
     def _decode_matrix(self, data):
         """Decode a special list to a Numpy array.
@@ -276,13 +780,16 @@ class TransplantMaster:
 
         """
 
-        dtype, shape, data = data[1:]
+        order = data[4] if len(data) == 5 else 'C'
+        dtype, shape, data = data[1:4]
+        if isinstance(data, list) and data[0] == "__compressed__":
+            data = zlib.decompress(data[3])
         if isinstance(data, str):
             out = np.fromstring(base64.b64decode(data.encode()), dtype)
         else:
             out = np.frombuffer(data, dtype)
         shape = [int(n) for n in shape]; # numpy requires integer indices
-        return out.reshape(*shape)
+        return out.reshape(shape, order=order)
 
     def _encode_sparse_matrix(self, data):
         """Encode a scipy.sparse matrix as a special list.
@@ -298,9 +805,34 @@ class TransplantMaster:
 
         # import scipy here to avoid a global import
         import scipy.sparse
+        if self._sparse_csc:
+            return self._encode_sparse_csc_matrix(data)
         return ["__sparse__", data.shape] + \
             [self._encode_matrix(d) for d in scipy.sparse.find(data)]
 
+    def _encode_sparse_csc_matrix(self, data):
+        """Encode a scipy.sparse matrix as its raw CSC buffers.
+
+        A sparse matrix `[[2, 0], [0, 3]]` would be encoded as
+        `["__sparse_csc__", [2, 2],
+          <matrix for column pointers [0, 1, 2]>,
+          <matrix for row indices [0, 1]>,
+          <matrix for values [2, 3]>]`.
+
+        In contrast to `__sparse__`, the nonzeros travel in
+        column-major CSC order, which is Matlab's native sparse
+        storage, so neither side has to sort entries.
+        """
+
+        import scipy.sparse
+        matrix = scipy.sparse.csc_matrix(data)
+        if matrix.nnz == 0:
+            return ["__sparse_csc__", matrix.shape, None, None, None]
+        return ["__sparse_csc__", matrix.shape,
+                self._encode_matrix(matrix.indptr),
+                self._encode_matrix(matrix.indices),
+                self._encode_matrix(matrix.data)]
+
     def _decode_sparse_matrix(self, data):
         """Decode a special list to a scipy.sparse matrix.
 
@@ -323,6 +855,90 @@ class TransplantMaster:
         shape = (int(d) for d in data[1]) # convert shape to int
         return scipy.sparse.coo_matrix((value, (row, col)), shape=shape)
 
+    def _decode_sparse_csc_matrix(self, data):
+        """Decode a special list of raw CSC buffers to a sparse matrix.
+
+        A sparse matrix
+        `["__sparse_csc__", [2, 2],
+          <matrix for column pointers [0, 1, 2]>,
+          <matrix for row indices [0, 1]>,
+          <matrix for values [2, 3]>]`,
+        where each `matrix` is encoded according to `_encode_matrix`,
+        would be decoded as `[[2, 0], [0, 3]]`. The buffers are used
+        as-is, without sorting or copying the nonzeros.
+        """
+
+        # import scipy here to avoid a global import
+        import scipy.sparse
+        shape = tuple(int(d) for d in data[1])
+        if data[2] is None:
+            return scipy.sparse.csc_matrix(shape)
+        indptr = self._decode_matrix(data[2]).ravel()
+        indices = self._decode_matrix(data[3]).ravel()
+        values = self._decode_matrix(data[4]).ravel()
+        return scipy.sparse.csc_matrix((values, indices, indptr),
+                                       shape=shape)
+
+    def _decode_gpu_matrix(self, data):
+        """Decode a special list to a CuPy array on the same device.
+
+        A gpuArray of `single([[1, 2], [3, 4]])` would be encoded as
+        `["__gpu_matrix__", "float32", [2, 2], <ipc handle bytes>,
+          <device index>, <keep-alive handle>]`.
+
+        The buffer is copied device-to-device through the CUDA IPC
+        handle, without a host round trip. The remote parks the
+        gpuArray in its proxy cache to keep the device buffer alive;
+        it is released once the copy is done.
+        """
+
+        # import cupy here to avoid a global import
+        import cupy
+        dtype, shape, handle, device, keepalive = data[1:]
+        shape = [int(s) for s in shape]
+        count = int(np.prod(shape))
+        nbytes = count * np.dtype(dtype).itemsize
+        with cupy.cuda.Device(int(device)):
+            ptr = cupy.cuda.runtime.ipcOpenMemHandle(bytes(handle))
+            try:
+                source = cupy.cuda.MemoryPointer(
+                    cupy.cuda.UnownedMemory(ptr, nbytes, None), 0)
+                out = cupy.empty(count, dtype=dtype)
+                out.data.copy_from_device(source, nbytes)
+            finally:
+                cupy.cuda.runtime.ipcCloseMemHandle(ptr)
+        self._del_proxy(keepalive)
+        # Matlab buffers are in Fortran storage order:
+        return out.reshape(shape, order='F')
+
+    def _decode_string_array(self, data):
+        """Decode a packed list of strings to a numpy object array.
+
+        A string list
+        `["__string_array__", <matrix for end offsets [2, 3]>, b'abc']`
+        would be decoded as `np.array(['ab', 'c'], dtype=object)`.
+
+        The remote emits this for large cell arrays of strings, so
+        they travel as two buffers instead of one msgpack object per
+        string.
+        """
+
+        ends = self._decode_matrix(data[1]).ravel()
+        buffer = data[2]
+        if buffer is None:
+            # an empty uint8 buffer arrives as nil:
+            buffer = b''
+        elif isinstance(buffer, int):
+            # dumpmsgpack packs a single uint8 as a plain integer
+            # instead of a bin value:
+            buffer = bytes([buffer])
+        out = np.empty(len(ends), dtype=object)
+        start = 0
+        for n, end in enumerate(ends):
+            out[n] = buffer[start:end].decode('utf-8')
+            start = end
+        return out
+
     def _encode_proxy(self, data):
         """Encode a ProxyObject as a special list.
 
@@ -361,10 +977,34 @@ class MatlabProxyObject:
         """foo"""
         self.__dict__['handle'] = handle
         self.__dict__['process'] = process
+        self.__dict__['classname'] = None
 
     def _getAttributeNames(self):
         return self.process.fieldnames(self)
 
+    def _class_metadata(self):
+        """Fetch the property and method names of the object's class.
+
+        The names are cached per class on the Matlab instance, so the
+        discovery round trips only happen once per class per session.
+
+        """
+        m = self.process
+        if self.__dict__['classname'] is None:
+            self.__dict__['classname'] = getattr(m, 'class')(self)
+        classname = self.__dict__['classname']
+        if classname not in m._proxy_classes:
+            properties = m.properties(self, nargout=1)
+            methods = m.methods(self, nargout=1)
+            # a single name comes back as a plain string:
+            if isinstance(properties, str):
+                properties = [properties]
+            if isinstance(methods, str):
+                methods = [methods]
+            m._proxy_classes[classname] = dict(properties=set(properties),
+                                               methods=set(methods))
+        return m._proxy_classes[classname]
+
     def __getattr__(self, name):
         """Retrieve a value or function from the object.
 
@@ -375,11 +1015,14 @@ class MatlabProxyObject:
 
         """
         m = self.process
-        # if it's a property, just retrieve it
-        if name in m.properties(self, nargout=1):
-            return m.subsref(self, MatlabStruct(m.substruct('.', name)))
+        metadata = self._class_metadata()
+        # if it's a property, just retrieve it (in one round trip)
+        if name in metadata['properties']:
+            response = m.send_message('get_attr', handle=self.handle,
+                                      name=name)
+            return response['value']
         # if it's a method, wrap it in a functor
-        if name in m.methods(self, nargout=1):
+        if name in metadata['methods']:
             class matlab_method:
                 def __call__(_self, *args, nargout=-1, **kwargs):
                     # serialize keyword arguments:
@@ -389,13 +1032,13 @@ class MatlabProxyObject:
                 # only fetch documentation when it is actually needed:
                 @property
                 def __doc__(_self):
-                    classname = getattr(m, 'class')(self)
+                    classname = self.__dict__['classname']
                     return m.help('{0}.{1}'.format(classname, name), nargout=1)
             return matlab_method()
 
     def __setattr__(self, name, value):
-        access = MatlabStruct(self.process.substruct('.', name))
-        self.process.subsasgn(self, access, value)
+        self.process.send_message('set_attr', handle=self.handle,
+                                  name=name, value=value)
 
     def __repr__(self):
         getclass = self.process.str2func('class')
@@ -414,11 +1057,149 @@ class MatlabProxyObject:
         return self.process.help(self, nargout=1)
 
 
+class MatlabMatrixHandle:
+    """A handle to a matrix that stays in the Matlab workspace.
+
+    Matrices above the negotiated ``matrix_handle_threshold`` are not
+    transferred, but stay in Matlab, and only this handle is sent.
+    Its :attr:`shape` and :attr:`dtype` are available locally, and
+    indexing it with slices or integers fetches only the requested
+    part of the matrix. Use :meth:`gather` (or :func:`numpy.asarray`)
+    to fetch the whole matrix, and pass the handle into function
+    calls to use the matrix in Matlab without any transfer at all.
+
+    Negative step sizes are not supported.
+
+    """
+
+    def __init__(self, process, dtype, shape, handle):
+        self.process = process
+        self.dtype = dtype
+        self.shape = tuple(int(n) for n in shape)
+        self.handle = handle
+
+    def __getitem__(self, index):
+        if not isinstance(index, tuple):
+            index = (index,)
+        if len(index) > len(self.shape):
+            raise IndexError('too many indices for matrix handle')
+        # pad missing dimensions with full slices:
+        index = index + (slice(None),)*(len(self.shape)-len(index))
+        slices = []
+        lengths = []
+        scalar_dims = []
+        for dim, (idx, length) in enumerate(zip(index, self.shape)):
+            if isinstance(idx, slice):
+                start, stop, step = idx.indices(length)
+                if step < 0:
+                    raise IndexError('matrix handles do not support '
+                                     'negative step sizes')
+            else:
+                idx = int(idx)
+                if idx < 0:
+                    idx += length
+                if not 0 <= idx < length:
+                    raise IndexError('index {} is out of bounds for '
+                                     'dimension {} with size {}'
+                                     .format(idx, dim, length))
+                start, stop, step = idx, idx+1, 1
+                scalar_dims.append(dim)
+            slices.append([start, stop, step])
+            lengths.append(max(0, -(-(stop - start) // step)))
+        response = self.process.send_message('fetch_matrix',
+                                             handle=self.handle,
+                                             slices=slices)
+        # the block arrives by value with the same shape it has in
+        # Matlab, which matches `lengths`:
+        out = np.asarray(response['value'])
+        # drop the dimensions that were indexed with an integer:
+        out = out.reshape([n for dim, n in enumerate(lengths)
+                           if dim not in scalar_dims])
+        if out.ndim == 0:
+            out = out[()]
+        return out
+
+    def gather(self):
+        """Fetch the whole matrix as a Numpy array."""
+        return self[(slice(None),) * len(self.shape)]
+
+    def __array__(self):
+        return np.asarray(self.gather())
+
+    def __repr__(self):
+        return ("<handle to Matlab {} matrix of shape {}>"
+                .format(self.dtype, self.shape))
+
+    def __del__(self):
+        self.process._del_proxy(self.handle)
+
+
 class MatlabStruct(dict):
     "Mark a dict to be decoded as struct instead of containers.Map"
     pass
 
 
+class MatlabBatch:
+    """Collects Matlab calls to be executed in a single round trip.
+
+    Within a ``with matlab.batch() as batch:`` block, function calls
+    on the batch object are not executed immediately, but return
+    :class:`concurrent.futures.Future` objects. When the block ends,
+    all collected calls are sent to Matlab as one message, executed
+    there in one loop, and the futures are resolved with the results.
+    Errors in individual calls resolve only that call's future.
+
+        with matlab.batch() as batch:
+            futures = [batch.max(data, nargout=1) for data in datasets]
+        maxima = [future.result() for future in futures]
+
+    """
+
+    def __init__(self, process):
+        self._process = process
+        self._calls = []
+        self._futures = []
+
+    def __getattr__(self, name):
+        """Record a function call instead of executing it."""
+        if name.startswith('_'):
+            raise AttributeError(name)
+        def record(*args, nargout=-1, **kwargs):
+            # serialize keyword arguments:
+            args += sum(kwargs.items(), ())
+            future = Future()
+            self._calls.append(dict(name=name, args=list(args),
+                                    nargout=nargout))
+            self._futures.append(future)
+            return future
+        return record
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        if exc_type is None:
+            self.flush()
+
+    def flush(self):
+        """Execute all collected calls in one round trip."""
+        if not self._calls:
+            return
+        calls, futures = self._calls, self._futures
+        self._calls, self._futures = [], []
+        try:
+            response = self._process.send_message('call_batch', calls=calls)
+        except Exception as exc:
+            for future in futures:
+                future.set_exception(exc)
+            raise
+        for item, future in zip(response['results'], futures):
+            if item['type'] == 'error':
+                future.set_exception(self._process._make_error(item))
+            else:
+                future.set_result(item['value'])
+
+
 class MatlabFunction:
     """A Proxy for a Matlab function."""
     def __init__(self, parent, fun):
@@ -453,6 +1234,19 @@ class MatlabFunction:
         args += sum(kwargs.items(), ())
         return self._parent._call(self._fun, args, nargout=nargout)
 
+    def call_async(self, *args, nargout=-1, **kwargs):
+        """Call the Matlab function asynchronously.
+
+        Returns a :class:`concurrent.futures.Future` that resolves to
+        the function's return value. Several calls can be in flight at
+        the same time; Matlab works through them in order while Python
+        keeps running.
+
+        """
+        # serialize keyword arguments:
+        args += sum(kwargs.items(), ())
+        return self._parent._call_async(self._fun, args, nargout=nargout)
+
 
 class Matlab(TransplantMaster):
     """An instance of Matlab, running in its own process.
@@ -493,22 +1287,89 @@ class Matlab(TransplantMaster):
         ``"json"`` instead.
     address : str
         An address of a remote SSH-reachable machine on which to call
+        Matlab. All instances talking to the same host share a single
+        multiplexed, compressed SSH connection, through which the
+        messages are tunneled. After a transient network failure,
+        :meth:`reconnect` restores the tunnel without restarting
         Matlab.
     user : str
         The user name to use for the SSH connection (if ``address`` is
         given).
-    print_to_stdout : bool
+    print_to_stdout : bool or 'async'
         Whether to print outputs to stdout, defaults to ``True``.
+        With ``'async'``, output printed during function calls is
+        captured on the remote and forwarded over a dedicated
+        PUB/SUB channel with a bounded queue, so heavy output is
+        dropped under load instead of blocking Matlab on a full
+        stdout pipe.
     desktop : bool
         Whether to start Matlab with ``-nodesktop``, defaults to ``True``.
     jvm : bool
         Whether to start Matlab with ``-nojvm``, defaults to ``False``.
+    shm_threshold : int
+        If given, matrices bigger than this many bytes are passed
+        through shared memory-mapped files instead of the message
+        itself, which avoids several full copies per transfer. Only
+        available if Matlab runs on the same machine (no ``address``).
+    chunk_threshold : int
+        If given, matrices bigger than this many bytes are streamed as
+        fixed-size message frames instead of being embedded in a fully
+        buffered message, which bounds peak memory during transfers.
+        Only available with ``msgformat='msgpack'``.
+    compress_threshold : int
+        If given, matrices bigger than this many bytes are
+        zlib-compressed before transmission (if that actually shrinks
+        them), which trades some CPU time for wire bandwidth. Most
+        useful together with ``address``, where the network is
+        usually the bottleneck. Only available with
+        ``msgformat='msgpack'``, and requires the remote to have
+        either the compiled zlib codec or a JVM.
+    matrix_handle_threshold : int
+        If given, matrices bigger than this many bytes are not
+        transferred from Matlab, but stay in its workspace, and are
+        returned as :class:`MatlabMatrixHandle` objects that fetch
+        data on demand. See its documentation for details.
+    stripe_threshold : int
+        If given, matrices bigger than this many bytes are striped
+        across ``stripe_count`` parallel data sockets, so several
+        TCP streams (and libzmq I/O threads) carry them concurrently
+        instead of one. Control messages stay on the main socket.
+        With ``address``, the data sockets use the raw network
+        instead of the SSH tunnel. Only available with
+        ``msgformat='msgpack'``; concurrent sends on the Matlab side
+        require the compiled ``transplantzmq_mex`` (the calllib
+        fallback sends the stripes sequentially).
+    stripe_count : int
+        The number of parallel data sockets for striped transfers,
+        defaults to 4.
+    gpu_transfer : bool
+        Whether to transfer gpuArrays through CUDA IPC handles as
+        CuPy arrays on the same device, defaults to ``False``. This
+        replaces the gather/upload host round trip with a
+        device-to-device copy. Requires ``cupy``, the compiled
+        ``gpuipc_mex`` on the Matlab side, and Matlab on the same
+        machine (no ``address``); gpuArrays the IPC path cannot
+        express are gathered into host memory instead.
+    timing : bool
+        Whether to record per-message timing statistics, defaults to
+        ``False``. See :meth:`get_stats`. The overhead is a few
+        timestamps per message, so it is safe to leave on.
+    restore : str
+        The file name of a workspace snapshot written by
+        :meth:`save_session`, which is reloaded into the base
+        workspace during startup. This skips replaying the
+        computations that built the state after a crash or restart.
 
     """
 
     ProxyObject = MatlabProxyObject
 
-    def __init__(self, executable='matlab', arguments=tuple(), msgformat='msgpack', address=None, user=None, print_to_stdout=True, desktop=False, jvm=True):
+    # only set for remote (address=...) instances:
+    _ssh_address = None
+    _ssh_options = None
+    _ssh_forwards = None
+
+    def __init__(self, executable='matlab', arguments=tuple(), msgformat='msgpack', address=None, user=None, print_to_stdout=True, desktop=False, jvm=True, shm_threshold=None, chunk_threshold=None, compress_threshold=None, matrix_handle_threshold=None, stripe_threshold=None, stripe_count=4, gpu_transfer=False, timing=False, restore=None):
         """Starts a Matlab instance and opens a communication channel."""
         if msgformat not in ['msgpack', 'json']:
             raise ValueError('msgformat must be "msgpack" or "json"')
@@ -529,11 +1390,20 @@ class Matlab(TransplantMaster):
                 # generate a valid and unique local pathname
                 with tempfile.NamedTemporaryFile() as f:
                     zmq_address = 'ipc://' + f.name
+                pub_address = zmq_address + '-pub'
+                stripe_urls = [zmq_address + '-stripe' + str(n)
+                               for n in range(stripe_count)]
             else: # cygwin/win32
                 # ZMQ does not support ipc:// on Windows, so use tcp:// instead
                 from random import randint
                 port = randint(49152, 65535)
                 zmq_address = 'tcp://127.0.0.1:' + str(port)
+                pub_address = 'tcp://127.0.0.1:' + str(randint(49152, 65535))
+                stripe_urls = ['tcp://127.0.0.1:' + str(randint(49152, 65535))
+                               for n in range(stripe_count)]
+            # without a tunnel, the remote connects to the same
+            # address the master binds:
+            remote_pub_address = pub_address
 
             process_arguments = ([executable] + list(arguments) +
                                  ['-r', "addpath('{}');cd('{}');"
@@ -542,60 +1412,313 @@ class Matlab(TransplantMaster):
                                       msgformat, zmq_address, self._locate_libzmq()
 )])
         else:
-            # get local IP address
-            from socket import create_connection
-            with create_connection((address, 22)) as s:
-                local_address, _ = s.getsockname()
-            # generate a random port number
+            # generate random port numbers for both ends of the tunnel
             from random import randint
-            port = randint(49152, 65535)
-            zmq_address = 'tcp://' + local_address + ':' + str(port)
+            local_port = randint(49152, 65535)
+            local_pub_port = randint(49152, 65535)
+            remote_port = randint(49152, 65535)
+            remote_pub_port = randint(49152, 65535)
+            zmq_address = 'tcp://127.0.0.1:' + str(local_port)
+            pub_address = 'tcp://127.0.0.1:' + str(local_pub_port)
+            if stripe_threshold is not None:
+                # striped bulk data deliberately bypasses the SSH
+                # tunnel: one compressed TCP stream cannot saturate a
+                # fast link, so the data sockets use the raw network.
+                from socket import create_connection
+                with create_connection((address, 22)) as s:
+                    local_address, _ = s.getsockname()
+                stripe_urls = ['tcp://' + local_address + ':' +
+                               str(randint(49152, 65535))
+                               for n in range(stripe_count)]
             if user is not None:
                 address = '{}@{}'.format(user, address)
-            process_arguments = (['ssh', address, executable, '-wait'] + list(arguments) +
+            # all instances talking to the same host share a single
+            # multiplexed SSH connection (ControlMaster), which
+            # outlives the individual Matlab sessions (ControlPersist)
+            # and compresses the tunneled traffic (-C). The ZMQ
+            # traffic is reverse-forwarded through that tunnel instead
+            # of opening a raw TCP connection per instance, so Matlab
+            # only ever connects to localhost. See also reconnect().
+            self._ssh_address = address
+            self._ssh_options = ['-o', 'ControlMaster=auto',
+                                 '-o', 'ControlPath=~/.ssh/transplant-%r@%h:%p',
+                                 '-o', 'ControlPersist=10m',
+                                 '-C']
+            self._ssh_forwards = [
+                '-R', '{}:127.0.0.1:{}'.format(remote_port, local_port),
+                '-R', '{}:127.0.0.1:{}'.format(remote_pub_port, local_pub_port)]
+            remote_pub_address = 'tcp://127.0.0.1:' + str(remote_pub_port)
+            process_arguments = (['ssh'] + self._ssh_options +
+                                 self._ssh_forwards +
+                                 [address, executable, '-wait'] + list(arguments) +
                                  ['-r', '"transplant_remote {} {} {}"'
-                                      .format(msgformat, zmq_address, "zmq")])
+                                      .format(msgformat,
+                                              'tcp://127.0.0.1:' + str(remote_port),
+                                              "zmq")])
         if sys.platform == 'win32' or sys.platform == 'cygwin':
             process_arguments += ['-wait']
         self.msgformat = msgformat
+        # per-class property/method cache for proxy objects (see
+        # MatlabProxyObject._class_metadata):
+        self._proxy_classes = {}
+        # per-function nargout cache, filled from the resolved values
+        # the remote reports back with each call response:
+        self._nargout_cache = {}
         # Create a new ZMQ context instead of sharing the global ZMQ context.
         # We now have ownership of it, and can terminate it with impunity.
-        self.context = zmq.Context()
-        self.socket = self.context.socket(zmq.REQ)
+        # With striping, extra I/O threads let the parallel data
+        # sockets actually use separate CPU cores:
+        if stripe_threshold is not None:
+            self.context = zmq.Context(stripe_count + 1)
+        else:
+            self.context = zmq.Context()
+        # A DEALER socket against the remote's REP socket allows
+        # several requests to be in flight at the same time. The REP
+        # socket answers them strictly in order.
+        self.socket = self.context.socket(zmq.DEALER)
         self.socket.bind(zmq_address)
         # start Matlab, but make sure that it won't eat the REPL stdin
         # (stdin=DEVNULL).
         self.process = Popen(process_arguments, stdin=DEVNULL, stdout=PIPE)
+        self._start_ioloop()
         if print_to_stdout:
             self._start_reader()
         self.eval('0;') # no-op. Wait for Matlab startup to complete.
+        if restore is not None:
+            # reload a workspace snapshot (see save_session) before
+            # anything else runs:
+            self.send_message('restore_session', file=restore)
+        if address is None:
+            # the local remote always ships with this file, so it is
+            # guaranteed to understand order-preserving matrix
+            # transfers, which skip the permute/copy into C order on
+            # both sides. Remote machines might run an older
+            # transplant_remote, so they keep the old protocol:
+            self._set_option('matrix_order', True)
+            self._matrix_order = True
+            if msgformat == 'msgpack':
+                # let the remote tag its special values as msgpack
+                # ext values, so the unpacker recognizes them and
+                # _resolve can skip the walk over the decoded tree:
+                self._set_option('msgpack_ext', True)
+                self._msgpack_ext = True
+                # pack uniform cell arrays (strings, scalars) into
+                # buffer transfers instead of one container per
+                # element. This relies on msgpack's bin values; JSON
+                # would serialize the buffers as arrays of ints:
+                self._set_option('packed_arrays', True)
+            # ship sparse matrices as their raw CSC buffers, so
+            # neither side has to sort the nonzeros:
+            self._set_option('sparse_csc', True)
+            self._sparse_csc = True
+        if print_to_stdout == 'async':
+            # forward output captured during calls over a dedicated
+            # PUB/SUB channel instead of the blocking stdout pipe:
+            self._start_pub_reader(pub_address)
+            self._set_option('pub_url', remote_pub_address)
+        if shm_threshold is not None and address is None:
+            # negotiate a directory for shared memory-mapped matrices:
+            self._shm_dir = tempfile.mkdtemp(prefix='transplant-')
+            self._shm_threshold = int(shm_threshold)
+            self._set_option('shm_dir', self._shm_dir)
+            self._set_option('shm_threshold', self._shm_threshold)
+        if chunk_threshold is not None and msgformat == 'msgpack':
+            self._chunk_threshold = int(chunk_threshold)
+            self._set_option('chunk_threshold', self._chunk_threshold)
+        if stripe_threshold is not None and msgformat == 'msgpack':
+            # large matrices are striped across parallel data sockets
+            # (see _decode_striped_matrix). Like the main socket, the
+            # stripe sockets are only ever used by the I/O thread:
+            sockets = []
+            for url in stripe_urls:
+                socket = self.context.socket(zmq.PAIR)
+                socket.bind(url)
+                sockets.append(socket)
+            self._set_option('stripe_urls', stripe_urls)
+            self._set_option('stripe_threshold', int(stripe_threshold))
+            self._stripe_threshold = int(stripe_threshold)
+            self._stripe_sockets = sockets
+        if matrix_handle_threshold is not None:
+            self._set_option('matrix_handle_threshold',
+                             int(matrix_handle_threshold))
+        if compress_threshold is not None and msgformat == 'msgpack':
+            try:
+                self._set_option('compress_threshold', int(compress_threshold))
+                self._compress_threshold = int(compress_threshold)
+            except TransplantError:
+                # the remote has no zlib codec (neither the compiled
+                # MEX file nor a JVM), so send uncompressed:
+                warnings.warn('Matlab can not decompress messages, '
+                              'continuing without compression')
+        if gpu_transfer and address is None:
+            try:
+                import cupy  # noqa: F401
+                self._set_option('gpu_transfer', True)
+            except ImportError:
+                warnings.warn('cupy is not installed, '
+                              'gpuArrays will not be transferred')
+        if timing:
+            self._stats_lock = Lock()
+            self._stats = dict(messages=0, bytes_sent=0, bytes_received=0,
+                               phases={})
+            self._set_option('timing', True)
 
     def exit(self):
         """Close the connection, and kill the process."""
         super().exit()
+        # stop the I/O thread before closing its socket:
+        self._outbox.put((None, None, None))
+        self._iothread.join(timeout=1)
+        if self._stripe_sockets is not None:
+            for socket in self._stripe_sockets:
+                socket.close()
         self.socket.close()
         self.context.term()
+        if self._shm_dir is not None:
+            shutil.rmtree(self._shm_dir, ignore_errors=True)
+            self._shm_dir = None
+
+    def reconnect(self):
+        """Re-establish the SSH tunnel after a transient network failure.
+
+        Checks whether the shared SSH control master is still alive,
+        and starts a fresh one with the original port forwards if it
+        died with the network. The ZMQ sockets on both sides then
+        reconnect through the restored tunnel on their own, and the
+        Matlab session continues with its workspace intact.
+
+        This only helps if the Matlab process itself survived the
+        outage; if Matlab died, a new :class:`Matlab` instance is
+        needed.
+
+        """
+        if self._ssh_address is None:
+            raise ValueError('reconnect is only available for remote '
+                             '(address=...) instances')
+        check = Popen(['ssh'] + self._ssh_options +
+                      ['-O', 'check', self._ssh_address],
+                      stdin=DEVNULL, stdout=DEVNULL, stderr=DEVNULL)
+        if check.wait() != 0:
+            # the control master died with the network; start a fresh
+            # one that re-establishes the port forwards:
+            master = Popen(['ssh'] + self._ssh_options + ['-N', '-f'] +
+                           self._ssh_forwards + [self._ssh_address],
+                           stdin=DEVNULL)
+            if master.wait() != 0:
+                raise RuntimeError('could not re-establish the SSH tunnel '
+                                   'to ' + self._ssh_address)
+        if self._ioloop_error is not None:
+            # the I/O thread died with the tunnel; restart it. The
+            # launcher ssh process died as well, so Matlab liveness
+            # can no longer be judged from it, only from responses:
+            self._iothread.join(timeout=1)
+            self._detached = True
+            self._ioloop_error = None
+            self._start_ioloop()
+        # verify that Matlab still answers through the tunnel:
+        self.eval('0;')
+
+    def save_session(self, filename):
+        """Snapshot the base workspace into a file.
+
+        Every variable is serialized in the binary matrix format and
+        streamed to the file one variable at a time. Load the
+        snapshot into a fresh instance with
+        ``Matlab(restore=filename)``, which skips replaying the
+        computations that built the state. Matlab objects are
+        skipped with a warning, since they cannot be serialized
+        across sessions, and like all transfers, string variables
+        come back as char (scalars) or cellstr (arrays).
+
+        The file is written by the Matlab process, so with
+        ``address`` it ends up on the remote machine.
+
+        """
+        self.send_message('save_session', file=filename)
 
     def _call(self, name, args, nargout=-1):
         """Call a function on the remote."""
-        args = list(args)
-        try:
-            response = self.send_message('call', name=name, args=args,
+        if nargout == -1:
+            # pass the signature the remote resolved on an earlier
+            # call, so it can skip its nargout lookup:
+            nargout = self._nargout_cache.get(name, -1)
+        future = self.send_message_async('call', name=name, args=list(args),
                                          nargout=nargout)
+        try:
+            response = future.result()
         except KeyboardInterrupt as exc:
             # hand the interrupt down to Matlab:
             self.process.send_signal(SIGINT)
-            # receive outstanding message to get ZMQ back in the right state
-            if self.msgformat == 'msgpack':
-                response = msgpack.unpackb(self.socket.recv(), raw=False, max_bin_len=2**31-1)
-            else:
-                response = self.socket.recv_json()
+            # the zombified remote acknowledges the outstanding message,
+            # which resolves the future and gets ZMQ back in the right
+            # state:
+            try:
+                future.result()
+            except Exception:
+                pass
             # continue with the exception
             raise exc
 
+        resolved = response.get('nargout', -1)
+        if resolved >= 0:
+            self._nargout_cache[name] = int(resolved)
         if response['type'] == 'value':
             return response['value']
 
+    def get_stats(self):
+        """Return a snapshot of the timing statistics.
+
+        Requires the instance to be started with ``timing=True``.
+        Returns a dict with the number of ``messages``, the
+        ``bytes_sent`` and ``bytes_received``, and per-phase timings
+        in ``phases``. The phases are ``encode``, ``roundtrip``, and
+        ``decode`` as seen from Python, and ``remote_decode``,
+        ``execute``, and ``remote_encode`` as measured by Matlab.
+        Each phase records its ``total`` and ``max`` duration in
+        seconds, and a ``histogram`` of durations in power-of-two
+        buckets (a count at key `e` covers `2**(e-1)` to `2**e`
+        seconds).
+
+        """
+        if self._stats is None:
+            raise ValueError('timing statistics are only recorded if '
+                             'Matlab is started with timing=True')
+        with self._stats_lock:
+            return dict(self._stats,
+                        phases={phase: dict(data, histogram=dict(data['histogram']))
+                                for phase, data in self._stats['phases'].items()})
+
+    def batch(self):
+        """Collect several function calls into a single round trip.
+
+        Returns a :class:`MatlabBatch` context manager. See its
+        documentation for usage.
+
+        """
+        return MatlabBatch(self)
+
+    def _call_async(self, name, args, nargout=-1):
+        """Call a function on the remote, and return a Future for its
+        return value."""
+        if nargout == -1:
+            nargout = self._nargout_cache.get(name, -1)
+        response = self.send_message_async('call', name=name, args=list(args),
+                                           nargout=nargout)
+        future = Future()
+        def unwrap(finished):
+            exception = finished.exception()
+            if exception is not None:
+                future.set_exception(exception)
+            else:
+                result = finished.result()
+                resolved = result.get('nargout', -1)
+                if resolved >= 0:
+                    self._nargout_cache[name] = int(resolved)
+                future.set_result(result['value']
+                                  if result['type'] == 'value' else None)
+        response.add_done_callback(unwrap)
+        return future
+
     def _decode_function(self, data):
         """Decode a special list to a wrapper function."""
 
@@ -737,3 +1860,155 @@ class Matlab(TransplantMaster):
                     search_dirs.append(line.strip())
 
         return search_dirs
+
+
+class MatlabPool:
+    """A pool of Matlab instances that work through calls in parallel.
+
+    Function calls on the pool object are dispatched to the first free
+    worker, so uneven call durations do not leave workers idle. Use
+    :meth:`MatlabFunction.call_async` to keep all workers busy:
+
+        with MatlabPool(4, jvm=False) as pool:
+            futures = [pool.simulate.call_async(p) for p in parameters]
+            results = [future.result() for future in futures]
+
+    Attribute access returns a :class:`MatlabFunction` proxy; which
+    worker executes a call is decided when the call is scheduled.
+    Assigning an attribute sets a global variable on *all* workers.
+    Since workers are separate Matlab processes, by-value data (numbers,
+    matrices, structs) can go to any worker, but proxy objects returned
+    from one worker must not be passed into calls on the pool.
+
+    Parameters
+    ----------
+    workers : int
+        The number of Matlab instances to start.
+    **matlab_args : dict
+        All further keyword arguments are passed on to
+        :class:`Matlab` for each worker.
+
+    """
+
+    def __init__(self, workers=2, **matlab_args):
+        self.__dict__['_workers'] = [Matlab(**matlab_args)
+                                     for _ in range(workers)]
+        self.__dict__['_idle'] = Queue()
+        for worker in self._workers:
+            self._idle.put(worker)
+        self.__dict__['_executor'] = ThreadPoolExecutor(max_workers=workers)
+
+    def _call(self, name, args, nargout=-1):
+        """Call a function on the first free worker."""
+        return self._call_async(name, args, nargout=nargout).result()
+
+    def _call_async(self, name, args, nargout=-1):
+        """Schedule a function call onto the first free worker, and
+        return a Future for its return value."""
+        def run():
+            worker = self._idle.get()
+            try:
+                return worker._call(name, args, nargout=nargout)
+            finally:
+                self._idle.put(worker)
+        return self._executor.submit(run)
+
+    def __getattr__(self, name):
+        """Retrieve a function proxy that dispatches to a free worker."""
+        if name.startswith('_'):
+            raise AttributeError(name)
+        return MatlabFunction(self, name)
+
+    def __setattr__(self, name, value):
+        """Save a value as a named variable on all workers."""
+        for worker in self._workers:
+            worker._set_global(name, value)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.exit()
+
+    def exit(self):
+        """Close all connections, and kill all worker processes."""
+        self._executor.shutdown()
+        for worker in self._workers:
+            worker.exit()
+
+    def __del__(self):
+        self.exit()
+
+
+class MatlabDaemon:
+    """Keeps idle, pre-booted Matlab instances ready to be attached to.
+
+    Booting Matlab takes many seconds, which dominates the runtime of
+    short-lived jobs. A daemon boots a number of instances ahead of
+    time; :meth:`attach` then hands out a booted instance immediately,
+    and replaces it with a fresh boot in the background:
+
+        daemon = MatlabDaemon(warm=2, jvm=False)
+        matlab = daemon.attach()  # no boot delay (once warmed up)
+        matlab.eval('...')
+        matlab.exit()
+
+    Attached instances get a cleared base workspace, so they behave
+    like freshly started ones. They are owned by the caller from then
+    on, and must be closed with :meth:`Matlab.exit` as usual.
+
+    Parameters
+    ----------
+    warm : int
+        The number of idle instances to keep booted.
+    **matlab_args : dict
+        All further keyword arguments are passed on to
+        :class:`Matlab` for each instance.
+
+    """
+
+    def __init__(self, warm=1, **matlab_args):
+        self._matlab_args = matlab_args
+        self._idle = Queue()
+        self._closed = False
+        # boot one instance at a time, so warming up does not swamp
+        # the machine (or the license server):
+        self._booter = ThreadPoolExecutor(max_workers=1)
+        for _ in range(warm):
+            self._refill()
+
+    def _refill(self):
+        """Boot a replacement instance in the background."""
+        def boot():
+            if not self._closed:
+                self._idle.put(Matlab(**self._matlab_args))
+        self._booter.submit(boot)
+
+    def attach(self):
+        """Return a pre-booted Matlab instance with a clean workspace.
+
+        Blocks until an instance is booted, which is instantaneous
+        once the daemon is warmed up.
+        """
+        matlab = self._idle.get()
+        self._refill()
+        # reset the base workspace, so left-over state from the boot
+        # sequence can not leak into the job:
+        matlab._call('evalin', ['base', 'clear'], nargout=0)
+        return matlab
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.exit()
+
+    def exit(self):
+        """Stop refilling, and kill all idle instances."""
+        self._closed = True
+        self._booter.shutdown()
+        while not self._idle.empty():
+            self._idle.get().exit()
+
+    def __del__(self):
+        self.exit()
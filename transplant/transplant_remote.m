@@ -6,6 +6,8 @@
 %    with at least one key: 'type'
 %
 %    Depending on the message type, other keys may or may not be set.
+%    Any message may additionally carry a list of proxy handles
+%    'free_proxies' that should be released.
 %
 %    TRANSPLANT implements the following message types:
 %    - 'die': closes the 0MQ session and quits Matlab.
@@ -13,6 +15,13 @@
 %    - 'get_global': retrieve the value of a global variable 'name'.
 %    - 'del_proxy': remove cached object 'handle'.
 %    - 'call': call function 'name' with 'args' and 'nargout'.
+%    - 'call_batch': execute a list of 'calls' in one round trip.
+%    - 'set_option': set transfer option 'name' to 'value'.
+%    - 'save_session': snapshot the base workspace into 'file'.
+%    - 'restore_session': reload a workspace snapshot from 'file'.
+%    - 'fetch_matrix': fetch 'slices' of a matrix held by 'handle'.
+%    - 'get_attr': read property 'name' of the object at 'handle'.
+%    - 'set_attr': write 'value' to property 'name' of the object at 'handle'.
 %
 %    TRANSPLANT implements the following responses:
 %    - 'ack': received message successfully.
@@ -29,7 +38,9 @@
 
 function transplant_remote(msgformat, url, zmqname, is_zombie)
     % this must be persistent to survive a SIGINT:
-    persistent proxied_objects is_receiving should_die messenger
+    persistent proxied_objects free_slots is_receiving should_die messenger
+    persistent use_msgpack_mex use_zlib_mex use_complex_mex use_gpuipc_mex options
+    persistent nargout_cache
 
     % since the onCleanup prevents direct exit, quit here after revival before
     % a new onCleanup is created:
@@ -37,13 +48,62 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
         return
     end
 
+    % chunked matrix content travels in additional message frames,
+    % collected here between encoding/decoding and the socket. This is
+    % initialized before the zombie revival paths below, which may
+    % send messages:
+    outgoing_chunks = {};
+    incoming_chunks = {};
+    % striped matrix content travels on the parallel data sockets.
+    % Records name their stripe set by sequence number, so sets read
+    % ahead of the decode walk are stashed here (see
+    % decode_striped_matrix):
+    stripes_sent = 0;
+    incoming_stripes = {};
+    stripes_read = 0;
+    % per-message phase timings, only recorded if the 'timing' option
+    % is set (see send_message):
+    timings = containers.Map();
+    execute_timer = tic;
+
     try
         if nargin == 3
             % normal startup
             messenger = ZMQ(zmqname, url);
             proxied_objects = {};
+            free_slots = [];
             is_receiving = false;
             should_die = false;
+            % use the compiled msgpack codec if it is available (see
+            % build_transplant_mex.m):
+            use_msgpack_mex = exist('dumpmsgpack_mex', 'file') == 3 && ...
+                              exist('parsemsgpack_mex', 'file') == 3;
+            use_zlib_mex = exist('zlibcompress_mex', 'file') == 3 && ...
+                           exist('zlibdecompress_mex', 'file') == 3;
+            % these only compile on Matlab with interleaved complex
+            % storage (R2018a+), so their existence implies support:
+            use_complex_mex = exist('complex2bytes_mex', 'file') == 3 && ...
+                              exist('bytes2complex_mex', 'file') == 3;
+            use_gpuipc_mex = exist('gpuipc_mex', 'file') == 3;
+            % per-function nargout cache (see call_function):
+            nargout_cache = containers.Map();
+            % transfer options, negotiated by the master via 'set_option':
+            options = containers.Map();
+            options('shm_dir') = '';
+            options('shm_threshold') = inf;
+            options('chunk_threshold') = inf;
+            options('chunk_size') = 2^24;
+            options('timing') = false;
+            options('compress_threshold') = inf;
+            options('matrix_handle_threshold') = inf;
+            options('matrix_order') = false;
+            options('msgpack_ext') = false;
+            options('pub_url') = '';
+            options('stripe_urls') = {};
+            options('stripe_threshold') = inf;
+            options('sparse_csc') = false;
+            options('packed_arrays') = false;
+            options('gpu_transfer') = false;
         elseif nargin > 3 && is_zombie && ~is_receiving
             % SIGINT has killed transplant_remote, but onCleanup has revived it
             % At this point, neither lasterror nor MException.last is available,
@@ -71,6 +131,17 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
             msg = receive_msg();
             is_receiving = false;
             msg = decode_values(msg);
+            if isKey(msg, 'free_proxies')
+                % proxy deletions queued by the master ride along on
+                % any message:
+                handles = msg('free_proxies');
+                if ~iscell(handles)
+                    handles = num2cell(handles);
+                end
+                for n=1:numel(handles)
+                    release_slot(handles{n});
+                end
+            end
             switch msg('type')
                 case 'die' % exit matlab
                     send_ack();
@@ -103,70 +174,234 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
                     end
                     send_value(value);
                 case 'del_proxy' % invalidate cached object
-                    proxied_objects{msg('handle')} = [];
+                    release_slot(msg('handle'));
+                    send_ack();
+                case 'set_option' % set a transfer option
+                    if strcmp(msg('name'), 'compress_threshold') && ...
+                       ~(use_zlib_mex || usejava('jvm'))
+                        error('TRANSPLANT:nozlib', ...
+                              ['No zlib codec available (compile ' ...
+                               'zlibcompress_mex or enable the JVM).']);
+                    end
+                    if strcmp(msg('name'), 'pub_url')
+                        % output captured during calls is published on
+                        % this side channel (see the 'call' case):
+                        messenger.open_pub(msg('value'));
+                    end
+                    if strcmp(msg('name'), 'stripe_urls')
+                        % large matrix payloads are striped across
+                        % these parallel data sockets (see
+                        % encode_matrix and decode_striped_matrix):
+                        messenger.open_stripes(msg('value'));
+                    end
+                    options(msg('name')) = msg('value');
+                    send_ack();
+                case 'save_session' % snapshot the base workspace
+                    save_session(msg('file'));
+                    send_ack();
+                case 'restore_session' % reload a workspace snapshot
+                    restore_session(msg('file'));
+                    send_ack();
+                case 'fetch_matrix' % fetch a slice of a held matrix
+                    value = proxied_objects{double(msg('handle'))};
+                    slices = msg('slices');
+                    subs = cell(1, numel(slices));
+                    for d=1:numel(slices)
+                        % slices arrive per dimension in Matlab order,
+                        % but zero-based and half-open:
+                        s = cellfun(@double, slices{d});
+                        subs{d} = (s(1)+1):s(3):s(2);
+                    end
+                    % the requested slice is always sent by value,
+                    % however big it is:
+                    threshold = options('matrix_handle_threshold');
+                    options('matrix_handle_threshold') = inf;
+                    try
+                        send_value(value(subs{:}));
+                        options('matrix_handle_threshold') = threshold;
+                    catch fetch_err
+                        options('matrix_handle_threshold') = threshold;
+                        rethrow(fetch_err);
+                    end
+                case 'get_attr' % read a property of a proxied object
+                    object = proxied_objects{double(msg('handle'))};
+                    send_value(subsref(object, substruct('.', msg('name'))));
+                case 'set_attr' % write a property of a proxied object
+                    handle = double(msg('handle'));
+                    object = subsasgn(proxied_objects{handle}, ...
+                                      substruct('.', msg('name')), ...
+                                      msg('value'));
+                    % store the result back, so property writes work
+                    % on value classes, too (handle classes return the
+                    % same handle):
+                    proxied_objects{handle} = object;
                     send_ack();
                 case 'call' % call a function
-                    fun = str2func(msg('name'));
-
-                    % get the number of output arguments
-                    if isKey(msg, 'nargout') && msg('nargout') >= 0
-                        resultsize = msg('nargout');
+                    if isempty(options('pub_url'))
+                        [result, has_result, resultsize] = call_function(msg);
                     else
-                        try
-                            resultsize = nargout(fun);
-                        catch % nargout fails if fun is a method:
-                            try
-                                resultsize = nargout(msg('name'));
-                            catch
-                                resultsize = -1;
-                            end
+                        % capture printed output, and publish it on
+                        % the side channel instead of blocking on a
+                        % full stdout pipe:
+                        printed = evalc(['[result, has_result, ' ...
+                                         'resultsize] = call_function(msg);']);
+                        if ~isempty(printed)
+                            messenger.publish(unicode2native(printed, 'utf-8'));
                         end
                     end
-
-                    if resultsize > 0
-                        % call the function with the given number of
-                        % output arguments:
-                        results = cell(resultsize, 1);
-                        args = msg('args');
-                        [results{:}] = fun(args{:});
-                        if length(results) == 1
-                            send_value(results{1});
-                        else
-                            send_value(results);
-                        end
+                    % report the resolved nargout back, so the master
+                    % can pass it explicitly on subsequent calls. An
+                    % explicit nargout from the caller is not echoed,
+                    % since caching it would change the signature of
+                    % later default-nargout calls:
+                    extra = containers.Map();
+                    if ~(isKey(msg, 'nargout') && msg('nargout') >= 0)
+                        extra('nargout') = resultsize;
+                    end
+                    if has_result
+                        send_value(result, extra);
                     else
-                        % try to get output from ans:
-                        clear('ans');
-                        args = msg('args');
-                        fun(args{:});
+                        send_ack(extra);
+                    end
+                case 'call_batch' % call several functions in one round trip
+                    calls = msg('calls');
+                    results = cell(1, numel(calls));
+                    for call_idx=1:numel(calls)
+                        item = containers.Map();
                         try
-                            send_value(ans);
-                        catch err
-                            send_ack();
+                            if isempty(options('pub_url'))
+                                [result, has_result] = call_function(calls{call_idx});
+                            else
+                                printed = evalc(['[result, has_result] = ' ...
+                                                 'call_function(calls{call_idx});']);
+                                if ~isempty(printed)
+                                    messenger.publish(unicode2native(printed, 'utf-8'));
+                                end
+                            end
+                            item('type') = 'value';
+                            if has_result
+                                item('value') = encode_values(result);
+                            else
+                                item('value') = [];
+                            end
+                        catch call_err
+                            % errors in one call don't abort the batch;
+                            % they are reported per item instead.
+                            item('type') = 'error';
+                            item('identifier') = call_err.identifier;
+                            item('message') = call_err.message;
+                            item('stack') = call_err.stack;
                         end
+                        results{call_idx} = item;
                     end
+                    message = containers.Map();
+                    message('results') = results;
+                    send_message('value', message);
             end
         catch err
             send_error(err)
         end
     end
 
+    % Call a function described by a message
+    %
+    % MSG is a Map with the function 'name', its 'args', and optionally
+    % an explicit 'nargout'. Returns the function's result, and whether
+    % there was a result at all (functions called with nargout <= 0
+    % might not define `ans`).
+    function [result, has_result, resultsize] = call_function(msg)
+        fun = str2func(msg('name'));
+
+        % get the number of output arguments
+        if isKey(msg, 'nargout') && msg('nargout') >= 0
+            resultsize = msg('nargout');
+        elseif isKey(nargout_cache, msg('name'))
+            % skip the exception machinery below on repeated calls:
+            resultsize = nargout_cache(msg('name'));
+        else
+            try
+                resultsize = nargout(fun);
+            catch % nargout fails if fun is a method:
+                try
+                    resultsize = nargout(msg('name'));
+                catch
+                    resultsize = -1;
+                end
+            end
+            nargout_cache(msg('name')) = resultsize;
+        end
+
+        if resultsize > 0
+            % call the function with the given number of
+            % output arguments:
+            results = cell(resultsize, 1);
+            args = msg('args');
+            [results{:}] = fun(args{:});
+            if length(results) == 1
+                result = results{1};
+            else
+                result = results;
+            end
+            has_result = true;
+        else
+            % try to get output from ans:
+            clear('ans');
+            args = msg('args');
+            fun(args{:});
+            try
+                result = ans;
+                has_result = true;
+            catch
+                result = [];
+                has_result = false;
+            end
+        end
+    end
+
     % Send a message
     %
     % This is the base function for the specialized senders below
     function send_message(message_type, message)
         message('type') = message_type;
+        if options('timing')
+            % the time since the request was decoded, minus the time
+            % spent encoding the reply, was spent executing it:
+            total = toc(execute_timer);
+            if isKey(timings, 'encode')
+                timings('execute') = total - timings('encode');
+            else
+                timings('execute') = total;
+            end
+            message('timings') = timings;
+            timings = containers.Map();
+        end
         if strcmp(msgformat, 'msgpack')
-            messenger.send(dumpmsgpack(message));
+            if use_msgpack_mex
+                blob = dumpmsgpack_mex(message, options('msgpack_ext'));
+            else
+                blob = dumpmsgpack(message, options('msgpack_ext'));
+            end
+        else
+            blob = unicode2native(dumpjson(message), 'utf-8');
+        end
+        if isempty(outgoing_chunks)
+            messenger.send(blob);
         else
-            str = dumpjson(message);
-            messenger.send(unicode2native(str, 'utf-8'));
+            messenger.send_multipart([{blob} outgoing_chunks]);
+            outgoing_chunks = {};
         end
+        % stripe sequence numbers are per-message:
+        stripes_sent = 0;
     end
 
     % Send an acknowledgement message
-    function send_ack()
-        send_message('ack', containers.Map());
+    %
+    % EXTRA is an optional Map of additional keys to send along.
+    function send_ack(extra)
+        if nargin < 1
+            extra = containers.Map();
+        end
+        send_message('ack', extra);
     end
 
     % Send an error message
@@ -186,28 +421,150 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
     end
 
     % Send a message that contains a value
-    function send_value(value)
-        message = containers.Map();
-        message('value') = encode_values(value);
+    %
+    % EXTRA is an optional Map of additional keys to send along.
+    function send_value(value, extra)
+        if nargin < 2
+            message = containers.Map();
+        else
+            message = extra;
+        end
+        if options('timing')
+            encode_start = tic;
+            message('value') = encode_values(value);
+            timings('encode') = toc(encode_start);
+        else
+            message('value') = encode_values(value);
+        end
         send_message('value', message);
     end
 
     % Wait for and receive a message
     function message = receive_msg()
-        blob = messenger.receive();
+        parts = messenger.receive_multipart();
+        decode_start = tic;
+        blob = parts{1};
+        incoming_chunks = parts(2:end);
+        incoming_stripes = {};
+        stripes_read = 0;
         if strcmp(msgformat, 'msgpack')
-            message = decode_values(parsemsgpack(blob));
+            if use_msgpack_mex
+                message = decode_values(parsemsgpack_mex(blob));
+            else
+                message = decode_values(parsemsgpack(blob));
+            end
         else
             str = native2unicode(blob, 'utf-8');
             message = decode_values(parsejson(str));
         end
+        % restart the timer even when timing is off, so the first
+        % timed reply (the ack that enables the option) doesn't record
+        % the entire uptime as execution time:
+        execute_timer = tic;
+        if options('timing')
+            timings = containers.Map();
+            timings('decode') = toc(decode_start);
+        end
+    end
+
+    % Serialize every variable of the base workspace into a file.
+    %
+    % Each variable becomes one length-prefixed msgpack record
+    % {name, encoded_value}, streamed to the file one at a time, so
+    % the snapshot never buffers the whole workspace. Matrices use
+    % the binary inline format regardless of the negotiated transfer
+    % options, since side channels and handles would not survive the
+    % session. Objects are skipped for the same reason: they only
+    % encode as session-local proxy handles. Like all transfers,
+    % string variables come back as char (scalars) or cellstr
+    % (arrays) after a restore.
+    function save_session(filename)
+        saved = {options('shm_dir'), options('chunk_threshold'), ...
+                 options('stripe_threshold'), ...
+                 options('matrix_handle_threshold')};
+        options('shm_dir') = '';
+        options('chunk_threshold') = inf;
+        options('stripe_threshold') = inf;
+        options('matrix_handle_threshold') = inf;
+        fid = fopen(filename, 'w');
+        if fid == -1
+            error('TRANSPLANT:cannotwritefile', ...
+                  ['Could not write ''' filename '''.']);
+        end
+        try
+            names = evalin('base', 'who');
+            for n=1:numel(names)
+                value = evalin('base', names{n});
+                if isobject(value) && ~isa(value, 'containers.Map') && ...
+                   ~isa(value, 'string')
+                    warning('TRANSPLANT:savesession:skipped', ...
+                            ['Skipping ''' names{n} ''', which cannot ' ...
+                             'be serialized across sessions.']);
+                    continue
+                end
+                record = {names{n}, encode_values(value)};
+                if use_msgpack_mex
+                    blob = dumpmsgpack_mex(record, false);
+                else
+                    blob = dumpmsgpack(record, false);
+                end
+                fwrite(fid, uint64(numel(blob)), 'uint64');
+                fwrite(fid, blob);
+            end
+        catch err
+            fclose(fid);
+            restore_transfer_options(saved);
+            rethrow(err);
+        end
+        fclose(fid);
+        restore_transfer_options(saved);
+    end
+
+    % Put the transfer options diverted by save_session back in place.
+    function restore_transfer_options(saved)
+        options('shm_dir') = saved{1};
+        options('chunk_threshold') = saved{2};
+        options('stripe_threshold') = saved{3};
+        options('matrix_handle_threshold') = saved{4};
+    end
+
+    % Reload a workspace snapshot written by save_session into the
+    % base workspace, one record at a time.
+    function restore_session(filename)
+        fid = fopen(filename, 'r');
+        if fid == -1
+            error('TRANSPLANT:cannotreadfile', ...
+                  ['Could not read ''' filename '''.']);
+        end
+        while true
+            len = fread(fid, 1, 'uint64');
+            if isempty(len)
+                break
+            end
+            blob = fread(fid, len, '*uint8')';
+            if use_msgpack_mex
+                record = parsemsgpack_mex(blob);
+            else
+                record = parsemsgpack(blob);
+            end
+            assignin('base', record{1}, decode_values(record{2}));
+        end
+        fclose(fid);
     end
 
     % recursively step through value and encode all occurrences of
     % matrices, objects and functions as special cell arrays.
     function [value] = encode_values(value)
         if issparse(value)
-            value = encode_sparse_matrix(value);
+            if options('sparse_csc')
+                value = encode_sparse_csc_matrix(value);
+            else
+                value = encode_sparse_matrix(value);
+            end
+        elseif isa(value, 'gpuArray') && options('gpu_transfer')
+            % this must come before the isnumeric branch, since
+            % gpuArrays masquerade as numeric:
+            value = encode_gpu_matrix(value);
         elseif (isnumeric(value) && numel(value) ~= 0 && ...
             (numel(value) > 1 || ~isreal(value)))
             value = encode_matrix(value);
@@ -225,7 +582,36 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
             value = encode_object(value);
         elseif isa(value, 'function_handle')
             value = {'__function__', func2str(value)};
+        elseif isa(value, 'string') && options('packed_arrays') && ...
+               numel(value) > 1 && isvector(value)
+            value = encode_string_array(cellstr(value));
+        elseif isa(value, 'string')
+            % strings have no wire representation of their own, so
+            % they travel as char (scalars) or cellstr (arrays), which
+            % is also how packed vector strings arrive on the other
+            % side:
+            value(ismissing(value)) = "";
+            if numel(value) == 1
+                value = char(value);
+            else
+                value = encode_values(cellstr(value));
+            end
         elseif iscell(value)
+            if options('packed_arrays') && numel(value) > 1 && isvector(value)
+                % large uniform cells travel as packed buffers instead
+                % of one container per element:
+                if all(cellfun('isclass', value, 'char')) && ...
+                   all(cellfun('size', value, 1) <= 1) && ...
+                   all(cellfun('ndims', value) == 2)
+                    value = encode_string_array(value);
+                    return
+                elseif all(cellfun('isclass', value, 'double')) && ...
+                       all(cellfun('prodofsize', value) == 1) && ...
+                       all(cellfun('isreal', value))
+                    value = {'__number_array__', encode_matrix([value{:}])};
+                    return
+                end
+            end
             for idx=1:numel(value)
                 value{idx} = encode_values(value{idx});
             end
@@ -246,10 +632,24 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
         if iscell(value)
             len = numel(value);
             special = len > 0 && ischar(value{1});
-            if special && len == 4 && strcmp(value{1}, '__matrix__')
+            if special && (len == 4 || len == 5) && strcmp(value{1}, '__matrix__')
                 value = decode_matrix(value);
+            elseif special && (len == 4 || len == 5) && strcmp(value{1}, '__shm_matrix__')
+                value = decode_shm_matrix(value);
+            elseif special && (len == 4 || len == 5) && strcmp(value{1}, '__chunked_matrix__')
+                value = decode_chunked_matrix(value);
+            elseif special && (len == 4 || len == 5) && strcmp(value{1}, '__striped_matrix__')
+                value = decode_striped_matrix(value);
+            elseif special && len == 4 && strcmp(value{1}, '__matrix_handle__')
+                value = proxied_objects{double(value{4})};
             elseif special && len == 5 && strcmp(value{1}, '__sparse__')
                 value = decode_sparse_matrix(value);
+            elseif special && len == 5 && strcmp(value{1}, '__sparse_csc__')
+                value = decode_sparse_csc_matrix(value);
+            elseif special && len == 3 && strcmp(value{1}, '__string_array__')
+                value = decode_string_array(value);
+            elseif special && len == 2 && strcmp(value{1}, '__number_array__')
+                value = num2cell(decode_matrix(value{2}));
             elseif special && len == 2 && strcmp(value{1}, '__object__')
                 value = proxied_objects{value{2}};
             elseif special && len == 2 && strcmp(value{1}, '__function__')
@@ -295,13 +695,29 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
                 out{n} = encode_object(object(n));
             end
         else
-            first_empty_entry = find(cellfun('isempty', proxied_objects), 1);
-            if isempty(first_empty_entry)
-                first_empty_entry = length(proxied_objects)+1;
-            end
-            proxied_objects{first_empty_entry} = object;
-            out = {'__object__', first_empty_entry};
+            out = {'__object__', claim_slot(object)};
+        end
+    end
+
+    % Store an object in the proxy cache and return its handle.
+    %
+    % Recycled slots are kept on an explicit free list, so claiming a
+    % slot is O(1) regardless of the number of cached objects.
+    function idx = claim_slot(object)
+        if ~isempty(free_slots)
+            idx = free_slots(end);
+            free_slots(end) = [];
+        else
+            idx = length(proxied_objects)+1;
         end
+        proxied_objects{idx} = object;
+    end
+
+    % Empty a slot in the proxy cache and put it on the free list.
+    function release_slot(handle)
+        handle = double(handle);
+        proxied_objects{handle} = [];
+        free_slots(end+1) = handle;
     end
 
     % The matrix `int32([1 2; 3 4])` would be encoded as
@@ -313,8 +729,45 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
         if ~isreal(value) && isinteger(value)
             value = double(value); % Numpy does not know complex int
         end
-        % convert column-major (Matlab, FORTRAN) to row-major (C, Python)
-        value = permute(value, length(size(value)):-1:1);
+        % translate Matlab class names into numpy dtypes
+        if isa(value, 'double') && isreal(value)
+            dtype = 'float64';
+        elseif isa(value, 'double')
+            dtype = 'complex128';
+        elseif isa(value, 'single') && isreal(value)
+            dtype = 'float32';
+        elseif isa(value, 'single')
+            dtype = 'complex64';
+        elseif isa(value, 'logical')
+            dtype = 'bool';
+        elseif isinteger(value)
+            dtype = class(value);
+        else
+            return % don't encode
+        end
+        % above the negotiated handle threshold, the matrix stays in
+        % the workspace, and only a handle is sent; the master fetches
+        % slices on demand via 'fetch_matrix':
+        info = whos('value');
+        if info.bytes > options('matrix_handle_threshold')
+            % the shape is reported as size(value), the same shape the
+            % matrix would have when transferred by value:
+            value = {'__matrix_handle__', dtype, size(value), ...
+                     claim_slot(value)};
+            return
+        end
+        if options('matrix_order')
+            % send native column-major bytes untouched; the master
+            % reconstructs the matrix with Fortran storage order:
+            shape = size(value);
+            order = {'F'};
+        else
+            % convert column-major (Matlab, FORTRAN) to row-major (C,
+            % Python), a full-array copy each way:
+            value = permute(value, length(size(value)):-1:1);
+            shape = fliplr(size(value));
+            order = {};
+        end
         % convert to uint8 1-D array
         if isreal(value)
             if islogical(value)
@@ -323,6 +776,10 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
             else
                 binary = typecast(value(:), 'uint8');
             end
+        elseif use_complex_mex
+            % with interleaved-complex storage (R2018a+), the wire
+            % bytes can be read directly, without any temporaries:
+            binary = complex2bytes_mex(value);
         else
             % convert [complex, complex] into [real, imag, real, imag]
             tmp = zeros(numel(value)*2, 1);
@@ -334,29 +791,173 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
             binary = typecast(tmp, 'uint8');
         end
         % not all typecasts return column vectors, so use (:)
+        binary = binary(:);
+        % large matrices are passed through a shared memory-mapped file
+        % instead of the message itself, if the master negotiated one:
+        if ~isempty(options('shm_dir')) && numel(binary) > options('shm_threshold')
+            value = [{'__shm_matrix__', dtype, shape, ...
+                      write_shm_segment(binary)} order];
+            return
+        end
+        % above the negotiated stripe threshold, the matrix content is
+        % striped across the parallel data sockets, one contiguous
+        % block per socket, so several TCP streams carry it at once:
+        if strcmp(msgformat, 'msgpack') && numel(binary) > options('stripe_threshold')
+            nstripes = numel(options('stripe_urls'));
+            blocksize = ceil(numel(binary)/nstripes);
+            blocks = cell(1, nstripes);
+            for n=1:nstripes
+                blocks{n} = binary((n-1)*blocksize+1:min(n*blocksize, end));
+            end
+            messenger.send_stripes(blocks);
+            % the record names its stripe set by sequence number,
+            % since the decode walk on the other side may visit the
+            % records in a different order than the encode walk sent
+            % them (containers.Map iterates its keys in sorted order):
+            value = [{'__striped_matrix__', dtype, shape, ...
+                      {stripes_sent, numel(binary)}} order];
+            stripes_sent = stripes_sent + 1;
+            return
+        end
+        % above the negotiated chunk threshold, the matrix content is
+        % streamed as fixed-size message frames instead of being
+        % embedded in the (fully buffered) msgpack blob:
+        if strcmp(msgformat, 'msgpack') && numel(binary) > options('chunk_threshold')
+            chunk_size = options('chunk_size');
+            nchunks = ceil(numel(binary)/chunk_size);
+            % the record names its frames by index, since the decode
+            % walk on the other side may visit the records in a
+            % different order than the encode walk appended them
+            % (containers.Map iterates its keys in sorted order):
+            base = numel(outgoing_chunks);
+            % slice off the last chunk first and truncate BINARY after
+            % each slice, so only one extra chunk-sized copy is alive
+            % at a time (truncating a vector at the tail is cheap):
+            for n=nchunks:-1:1
+                outgoing_chunks{base+n} = binary((n-1)*chunk_size+1:end);
+                binary((n-1)*chunk_size+1:end) = [];
+            end
+            value = [{'__chunked_matrix__', dtype, shape, ...
+                      {base, nchunks}} order];
+            return
+        end
+        % above the negotiated compression threshold, the matrix
+        % content is zlib-compressed, if that actually shrinks it:
+        if strcmp(msgformat, 'msgpack') && numel(binary) > options('compress_threshold')
+            compressed = zlib_compress(binary);
+            % skip incompressible data, where decompression would only
+            % add latency:
+            if numel(compressed) < 0.9*numel(binary)
+                binary = {'__compressed__', 'zlib', numel(binary), compressed};
+            end
+        end
         if strcmp(msgformat, 'json')
-            binary = base64encode(binary(:));
-        else
-            binary = binary(:);
+            binary = base64encode(binary);
         end
-        % translate Matlab class names into numpy dtypes
-        if isa(value, 'double') && isreal(value)
-            dtype = 'float64';
-        elseif isa(value, 'double')
-            dtype = 'complex128';
-        elseif isa(value, 'single') && isreal(value)
-            dtype = 'float32';
-        elseif isa(value, 'single')
-            dtype = 'complex64';
-        elseif isa(value, 'logical')
-            dtype = 'bool';
-        elseif isinteger(value)
-            dtype = class(value);
-        else
-            return % don't encode
+        value = [{'__matrix__', dtype, shape, binary} order];
+    end
+
+    % Write binary data to a new file in the negotiated shared directory
+    % and return its name. The receiving side deletes the file after
+    % mapping it.
+    function [filename] = write_shm_segment(binary)
+        filename = tempname(options('shm_dir'));
+        fid = fopen(filename, 'w');
+        fwrite(fid, binary);
+        fclose(fid);
+    end
+
+    % Compress bytes with zlib, using the compiled codec if it is
+    % available (see build_transplant_mex.m), and Java otherwise.
+    function [out] = zlib_compress(binary)
+        if use_zlib_mex
+            out = zlibcompress_mex(binary);
+            return
+        end
+        buffer = java.io.ByteArrayOutputStream();
+        % level 1 is fast enough to pay off whenever the wire is the
+        % bottleneck:
+        stream = java.util.zip.DeflaterOutputStream( ...
+            buffer, java.util.zip.Deflater(1));
+        stream.write(typecast(binary, 'int8'));
+        stream.close();
+        out = typecast(buffer.toByteArray(), 'uint8');
+        out = out(:);
+    end
+
+    % Decompress zlib-compressed bytes back into raw_len uint8s.
+    function [out] = zlib_decompress(binary, raw_len)
+        if use_zlib_mex
+            out = zlibdecompress_mex(binary, raw_len);
+            return
+        end
+        source = java.io.ByteArrayInputStream(typecast(binary, 'int8'));
+        stream = java.util.zip.InflaterInputStream(source);
+        sink = java.io.ByteArrayOutputStream(raw_len);
+        copier = com.mathworks.mlwidgets.io.InterruptibleStreamCopier ...
+            .getInterruptibleStreamCopier();
+        copier.copyStream(stream, sink);
+        stream.close();
+        out = typecast(sink.toByteArray(), 'uint8');
+        out = out(:);
+    end
+
+    % The matrix content of a `{'__shm_matrix__', dtype, shape, filename}`
+    % lives in a shared memory-mapped file instead of the message. Map
+    % the file, then decode it like a regular matrix.
+    function [value] = decode_shm_matrix(value)
+        filename = value{4};
+        map = memmapfile(filename);
+        value = decode_matrix([{'__matrix__', value{2}, value{3}, ...
+                                map.Data} value(5:end)]);
+        clear('map'); % unmap before deleting the file
+        delete(filename);
+    end
+
+    % The matrix content of a `{'__chunked_matrix__', dtype, shape,
+    % {first, nchunks}}` arrives in additional message frames instead
+    % of inline bytes. The frames are named by index, so the record
+    % decodes correctly no matter in which order the decode walk
+    % visits it. Copy the frames into a preallocated buffer, freeing
+    % each frame as soon as it is copied, then decode it like a
+    % regular matrix.
+    function [value] = decode_chunked_matrix(value)
+        frames = cellfun(@double, value{4});
+        first = frames(1);
+        nchunks = frames(2);
+        total = sum(cellfun('length', ...
+                            incoming_chunks(first+1:first+nchunks)));
+        binary = zeros(total, 1, 'uint8');
+        offset = 0;
+        for n=first+1:first+nchunks
+            chunk = incoming_chunks{n};
+            binary(offset+1:offset+numel(chunk)) = chunk;
+            offset = offset + numel(chunk);
+            incoming_chunks{n} = []; % free the frame right away
         end
-        % save as row-major (C, Python)
-        value = {'__matrix__', dtype, fliplr(size(value)), binary};
+        value = decode_matrix([{'__matrix__', value{2}, value{3}, ...
+                                binary} value(5:end)]);
+    end
+
+    % The matrix content of a `{'__striped_matrix__', dtype, shape,
+    % {seq, nbytes}}` arrives as one contiguous block per parallel
+    % data socket instead of inline bytes. The sockets deliver the
+    % stripe sets in the order they were sent, which may differ from
+    % the order in which the decode walk visits the records, so sets
+    % are read forward and stashed until the wanted sequence number
+    % arrives. Collect the blocks, then decode it like a regular
+    % matrix.
+    function [value] = decode_striped_matrix(value)
+        seq = double(value{4}{1});
+        while stripes_read <= seq
+            incoming_stripes{stripes_read+1} = messenger.receive_stripes();
+            stripes_read = stripes_read + 1;
+        end
+        blocks = incoming_stripes{seq+1};
+        incoming_stripes{seq+1} = []; % free the set right away
+        binary = [blocks{:}];
+        value = decode_matrix([{'__matrix__', value{2}, value{3}, ...
+                                binary(:)} value(5:end)]);
     end
 
     % The matrix `int32([1 2; 3 4])` would be encoded as
@@ -366,6 +967,11 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
     % `'AQAAAAIAAAADAAAABAAAA==\n'` is the base64-encoded matrix content.
     function [value] = decode_matrix(value)
         dtype = value{2};
+        if numel(value) == 5
+            order = value{5};
+        else
+            order = 'C';
+        end
         % make sure shape is a double array even if its elements are
         % less than double:
         shape = cellfun(@double, value{3});
@@ -374,20 +980,30 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
         elseif length(shape) == 1
             shape = [1 shape];
         end
-        if ischar(value{4})
+        if iscell(value{4}) && strcmp(value{4}{1}, '__compressed__')
+            binary = zlib_decompress(value{4}{4}, double(value{4}{3}));
+        elseif ischar(value{4})
             binary = base64decode(value{4});
         else
             binary = value{4};
         end
         % translate numpy dtypes into Matlab class names
         if strcmp(dtype, 'complex128')
-            value = typecast(binary, 'double')';
-            value = value(1:2:end) + 1i*value(2:2:end);
+            if use_complex_mex
+                value = bytes2complex_mex(binary, 'double');
+            else
+                value = typecast(binary, 'double')';
+                value = value(1:2:end) + 1i*value(2:2:end);
+            end
         elseif strcmp(dtype, 'float64')
             value = typecast(binary, 'double')';
         elseif strcmp(dtype, 'complex64')
-            value = typecast(binary, 'single')';
-            value = value(1:2:end) + 1i*value(2:2:end);
+            if use_complex_mex
+                value = bytes2complex_mex(binary, 'single');
+            else
+                value = typecast(binary, 'single')';
+                value = value(1:2:end) + 1i*value(2:2:end);
+            end
         elseif strcmp(dtype, 'float32')
             value = typecast(binary, 'single')';
         elseif strcmp(dtype, 'bool')
@@ -395,9 +1011,15 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
         else
             value = typecast(binary, dtype);
         end
-        % convert row-major (C, Python) to column-major (Matlab, FORTRAN)
-        value = reshape(value, fliplr(shape));
-        value = permute(value, length(shape):-1:1);
+        if strcmp(order, 'F')
+            % native column-major bytes; a reshape is all it takes
+            value = reshape(value, shape);
+        else
+            % convert row-major (C, Python) to column-major (Matlab,
+            % FORTRAN)
+            value = reshape(value, fliplr(shape));
+            value = permute(value, length(shape):-1:1);
+        end
     end
 
     % Encode a sparse matrix as a special list.
@@ -443,4 +1065,108 @@ function transplant_remote(msgformat, url, zmqname, is_zombie)
         value = sparse(row+1, col+1, data, shape(1), shape(2));
     end
 
+    % Encode a sparse matrix as its raw CSC buffers.
+    % A sparse matrix `[[2, 0], [0, 3]]` would be encoded as
+    % `{'__sparse_csc__', [2, 2],
+    %   <matrix for column pointers [0, 1, 2]>,
+    %   <matrix for row indices [0, 1]>,
+    %   <matrix for values [2, 3]>}`
+    %
+    % In contrast to '__sparse__', the shape is not flipped, and the
+    % nonzeros travel in Matlab's native column-major CSC order, which
+    % scipy.sparse.csc_matrix ingests without re-sorting.
+    function [value] = encode_sparse_csc_matrix(value)
+        if nnz(value) > 0
+            [row, ~] = find(value);
+            indptr = [0, cumsum(full(sum(value ~= 0, 1)))];
+            value = {'__sparse_csc__', size(value), ...
+                     encode_matrix(int64(indptr)), ...
+                     encode_matrix(int64(row) - 1), ...
+                     encode_matrix(nonzeros(value))};
+        else
+            % don't try to encode empty matrices as matrices
+            value = {'__sparse_csc__', size(value), [], [], []};
+        end
+    end
+
+    % Decode a special list of CSC buffers to a sparse matrix.
+    function [value] = decode_sparse_csc_matrix(value)
+        % make sure shape is a double array even if its elements are
+        % less than double:
+        shape = cellfun(@double, value{2});
+        if isempty(value{3})
+            value = sparse(shape(1), shape(2));
+            return
+        end
+        indptr = double(decode_matrix(value{3}));
+        row = double(decode_matrix(value{4})) + 1;
+        data = double(decode_matrix(value{5}));
+        % expand the column pointers into per-entry column indices;
+        % the entries are already in column-major order, so sparse()
+        % does not have to re-sort them:
+        col = repelem(1:shape(2), diff(indptr(:))');
+        value = sparse(row, col, data, shape(1), shape(2));
+    end
+
+    % Encode a gpuArray as a CUDA IPC handle.
+    % A gpuArray of `single([1 2; 3 4])` would be encoded as
+    % `{'__gpu_matrix__', 'float32', [2, 2], <ipc handle bytes>,
+    %   <device index>, <keep-alive handle>}`
+    %
+    % The master opens the IPC handle and copies the buffer
+    % device-to-device, without staging it through host memory or the
+    % socket. The device buffer must outlive the handle until the
+    % master is done copying, so the array is parked in the proxy
+    % cache, and the master releases it like any other proxy.
+    %
+    % Arrays that the IPC path cannot express (complex or logical
+    % values, or no compiled gpuipc_mex) are gathered into host
+    % memory and encoded normally.
+    function [value] = encode_gpu_matrix(value)
+        dtype = classUnderlying(value);
+        if ~use_gpuipc_mex || ~isreal(value) || ...
+           strcmp(dtype, 'logical') || isempty(value)
+            value = encode_values(gather(value));
+            return
+        end
+        switch dtype
+            case 'double'
+                dtype = 'float64';
+            case 'single'
+                dtype = 'float32';
+            % the integer class names already match numpy's dtypes
+        end
+        [handle, device] = gpuipc_mex(value);
+        value = {'__gpu_matrix__', dtype, size(value), handle, ...
+                 device, claim_slot(value)};
+    end
+
+    % Encode a cell array of strings as one packed buffer.
+    % The cellstr `{'ab', 'c'}` would be encoded as
+    % `{'__string_array__', <matrix for end offsets [2, 3]>,
+    %   uint8('abc')}`
+    %
+    % so a large list of labels travels as two buffers instead of one
+    % msgpack object per string.
+    function [value] = encode_string_array(value)
+        encoded = cellfun(@(str) unicode2native(str, 'utf-8'), ...
+                          value(:)', 'uniformoutput', false);
+        ends = cumsum(cellfun('length', encoded));
+        value = {'__string_array__', encode_matrix(int64(ends)), ...
+                 [encoded{:}]};
+    end
+
+    % Decode a packed list of strings to a cell array of strings.
+    function [value] = decode_string_array(value)
+        ends = double(decode_matrix(value{2}));
+        buffer = value{3};
+        out = cell(1, numel(ends));
+        start = 1;
+        for n=1:numel(ends)
+            out{n} = native2unicode(uint8(buffer(start:ends(n))), 'utf-8');
+            start = ends(n) + 1;
+        end
+        value = out;
+    end
+
 end
@@ -11,6 +11,7 @@ typedef long unsigned int size_t;
 int zmq_errno (void);
 
 void *zmq_ctx_new (void);
+int zmq_ctx_set (void *context, int option, int optval);
 int zmq_ctx_term (void *context);
 
 typedef struct zmq_msg_t {unsigned char hidden [64];} zmq_msg_t;
@@ -19,8 +20,10 @@ int zmq_msg_send (zmq_msg_t *msg, void *s, int flags);
 int zmq_msg_recv (zmq_msg_t *msg, void *s, int flags);
 int zmq_msg_close (zmq_msg_t *msg);
 void *zmq_msg_data (zmq_msg_t *msg);
+int zmq_msg_more (zmq_msg_t *msg);
 
 void *zmq_socket (void *, int type);
 int zmq_close (void *s);
 int zmq_connect (void *s, const char *addr);
+int zmq_setsockopt (void *s, int option, const void *optval, size_t optvallen);
 int zmq_send (void *s, const void *buf, size_t len, int flags);
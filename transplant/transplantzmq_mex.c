@@ -0,0 +1,203 @@
+/* TRANSPLANTZMQ_MEX sends and receives 0MQ messages without calllib
+ *
+ * This is a compiled replacement for the loadlibrary/calllib transport
+ * in ZMQ.m. The calllib marshalling layer copies every message through
+ * libpointer objects, which takes seconds for GB-sized messages.
+ * Here, received frames are copied with a single memcpy from libzmq's
+ * message buffer into a freshly allocated Matlab array, and sends read
+ * directly from array memory.
+ *
+ * The context and sockets live in this MEX file between calls:
+ *   TRANSPLANTZMQ_MEX('open', address)     connect a REP socket
+ *   [frame, more] = TRANSPLANTZMQ_MEX('receive')   read one frame
+ *   TRANSPLANTZMQ_MEX('send', data, more)  write one frame
+ *   TRANSPLANTZMQ_MEX('open_pub', address) connect the PUB channel
+ *   TRANSPLANTZMQ_MEX('publish', data)     write to the PUB channel
+ *   TRANSPLANTZMQ_MEX('open_stripes', urls)    connect the data sockets
+ *   TRANSPLANTZMQ_MEX('send_stripes', blocks)  one block per data socket
+ *   blocks = TRANSPLANTZMQ_MEX('receive_stripes')
+ *   TRANSPLANTZMQ_MEX('close')             close sockets and context
+ *
+ * Compile this with build_transplant_mex.m (it links against libzmq);
+ * ZMQ.m falls back to calllib if this file is not compiled.
+ */
+
+/* This code is licensed under the BSD 3-clause license */
+
+#include <string.h>
+#include "mex.h"
+
+/* the libzmq interface, as declared in transplantzmq.h; the library
+   itself is linked in at build time */
+void *zmq_ctx_new(void);
+int zmq_ctx_set(void *context, int option, int optval);
+int zmq_ctx_term(void *context);
+void *zmq_socket(void *context, int type);
+int zmq_close(void *socket);
+int zmq_connect(void *socket, const char *addr);
+int zmq_setsockopt(void *socket, int option, const void *optval,
+                   size_t optvallen);
+int zmq_send(void *socket, const void *buf, size_t len, int flags);
+typedef struct zmq_msg_t {unsigned char hidden [64];} zmq_msg_t;
+int zmq_msg_init(zmq_msg_t *msg);
+int zmq_msg_recv(zmq_msg_t *msg, void *socket, int flags);
+int zmq_msg_close(zmq_msg_t *msg);
+void *zmq_msg_data(zmq_msg_t *msg);
+size_t zmq_msg_size(zmq_msg_t *msg);
+int zmq_msg_more(zmq_msg_t *msg);
+int zmq_errno(void);
+const char *zmq_strerror(int errnum);
+
+#define ZMQ_PAIR 0
+#define ZMQ_PUB 1
+#define ZMQ_REP 4
+#define ZMQ_DONTWAIT 1
+#define ZMQ_SNDMORE 2
+#define ZMQ_SNDHWM 23
+#define ZMQ_IO_THREADS 1
+
+#define MAX_STRIPES 16
+
+static void *context = NULL;
+static void *socket = NULL;
+static void *pubsocket = NULL;
+static void *stripesockets[MAX_STRIPES];
+static int nstripes = 0;
+
+static void cleanup(void)
+{
+    int n;
+    for (n = 0; n < nstripes; n++)
+        zmq_close(stripesockets[n]);
+    nstripes = 0;
+    if (pubsocket != NULL) {
+        zmq_close(pubsocket);
+        pubsocket = NULL;
+    }
+    if (socket != NULL) {
+        zmq_close(socket);
+        socket = NULL;
+    }
+    if (context != NULL) {
+        zmq_ctx_term(context);
+        context = NULL;
+    }
+}
+
+static void fail(const char *instruction)
+{
+    mexErrMsgIdAndTxt("transplant:zmqmex:error", "Error in %s: %s",
+                      instruction, zmq_strerror(zmq_errno()));
+}
+
+static void *open_socket(const mxArray *address, int type, int hwm)
+{
+    char addr[256];
+    void *s;
+    if (context == NULL) {
+        context = zmq_ctx_new();
+        if (context == NULL)
+            fail("zmq_ctx_new");
+        /* several I/O threads let striped transfers push their data
+           sockets onto the wire concurrently; this must happen
+           before the first socket is created, and the idle threads
+           are harmless otherwise: */
+        zmq_ctx_set(context, ZMQ_IO_THREADS, 4);
+        mexAtExit(cleanup);
+    }
+    s = zmq_socket(context, type);
+    if (s == NULL)
+        fail("zmq_socket");
+    /* the high-water mark must be set before connecting: */
+    if (hwm > 0 && zmq_setsockopt(s, ZMQ_SNDHWM, &hwm, sizeof(hwm)) != 0)
+        fail("zmq_setsockopt");
+    if (mxGetString(address, addr, sizeof(addr)) != 0)
+        mexErrMsgIdAndTxt("transplant:zmqmex:argument",
+                          "invalid socket address");
+    if (zmq_connect(s, addr) != 0)
+        fail("zmq_connect");
+    return s;
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    char command[16];
+    if (nrhs < 1 || mxGetString(prhs[0], command, sizeof(command)) != 0)
+        mexErrMsgIdAndTxt("transplant:zmqmex:argument",
+                          "the first argument must be a command string");
+
+    if (strcmp(command, "open") == 0) {
+        socket = open_socket(prhs[1], ZMQ_REP, 0);
+    } else if (strcmp(command, "receive") == 0) {
+        zmq_msg_t msg;
+        int len;
+        zmq_msg_init(&msg); /* always returns 0 */
+        len = zmq_msg_recv(&msg, socket, 0);
+        if (len < 0) {
+            zmq_msg_close(&msg);
+            fail("zmq_msg_recv");
+        }
+        plhs[0] = mxCreateNumericMatrix(1, len, mxUINT8_CLASS, mxREAL);
+        memcpy(mxGetData(plhs[0]), zmq_msg_data(&msg), len);
+        if (nlhs > 1)
+            plhs[1] = mxCreateDoubleScalar(zmq_msg_more(&msg));
+        zmq_msg_close(&msg);
+    } else if (strcmp(command, "send") == 0) {
+        int flags = 0;
+        if (nrhs > 2 && mxGetScalar(prhs[2]) != 0)
+            flags = ZMQ_SNDMORE;
+        if (zmq_send(socket, mxGetData(prhs[1]),
+                     mxGetNumberOfElements(prhs[1]), flags) < 0)
+            fail("zmq_send");
+    } else if (strcmp(command, "open_pub") == 0) {
+        pubsocket = open_socket(prhs[1], ZMQ_PUB, 100);
+    } else if (strcmp(command, "open_stripes") == 0) {
+        int n, count = mxGetNumberOfElements(prhs[1]);
+        if (count > MAX_STRIPES)
+            mexErrMsgIdAndTxt("transplant:zmqmex:argument",
+                              "at most %d stripe sockets are supported",
+                              MAX_STRIPES);
+        for (n = 0; n < count; n++)
+            stripesockets[n] = open_socket(mxGetCell(prhs[1], n),
+                                           ZMQ_PAIR, 0);
+        nstripes = count;
+    } else if (strcmp(command, "send_stripes") == 0) {
+        /* the sends only queue the blocks; the I/O threads push the
+           streams onto the wire concurrently */
+        int n;
+        for (n = 0; n < nstripes; n++) {
+            const mxArray *block = mxGetCell(prhs[1], n);
+            if (zmq_send(stripesockets[n], mxGetData(block),
+                         mxGetNumberOfElements(block), 0) < 0)
+                fail("zmq_send");
+        }
+    } else if (strcmp(command, "receive_stripes") == 0) {
+        int n;
+        plhs[0] = mxCreateCellMatrix(1, nstripes);
+        for (n = 0; n < nstripes; n++) {
+            zmq_msg_t msg;
+            int len;
+            mxArray *block;
+            zmq_msg_init(&msg); /* always returns 0 */
+            len = zmq_msg_recv(&msg, stripesockets[n], 0);
+            if (len < 0) {
+                zmq_msg_close(&msg);
+                fail("zmq_msg_recv");
+            }
+            block = mxCreateNumericMatrix(1, len, mxUINT8_CLASS, mxREAL);
+            memcpy(mxGetData(block), zmq_msg_data(&msg), len);
+            mxSetCell(plhs[0], n, block);
+            zmq_msg_close(&msg);
+        }
+    } else if (strcmp(command, "publish") == 0) {
+        /* fire-and-forget: a full queue drops the message */
+        if (pubsocket != NULL)
+            zmq_send(pubsocket, mxGetData(prhs[1]),
+                     mxGetNumberOfElements(prhs[1]), ZMQ_DONTWAIT);
+    } else if (strcmp(command, "close") == 0) {
+        cleanup();
+    } else {
+        mexErrMsgIdAndTxt("transplant:zmqmex:argument",
+                          "unknown command \"%s\"", command);
+    }
+}
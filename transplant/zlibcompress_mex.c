@@ -0,0 +1,34 @@
+/* ZLIBCOMPRESS_MEX compresses a vector of uint8s with zlib
+ *
+ * This is the compiled half of the compression codec negotiated by
+ * the 'compress_threshold' option. It uses zlib at level 1, which is
+ * fast enough to pay off whenever the wire is the bottleneck.
+ * Compile it with build_transplant_mex.m (requires -lz);
+ * transplant_remote falls back to the Java codec if this file is not
+ * compiled.
+ */
+
+/* This code is licensed under the BSD 3-clause license */
+
+#include <zlib.h>
+#include "mex.h"
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    uLong srclen;
+    uLongf destlen;
+
+    if (nrhs != 1 || !mxIsUint8(prhs[0]))
+        mexErrMsgIdAndTxt("transplant:zlibcompress:argument",
+                          "zlibcompress_mex requires a uint8 array");
+    srclen = (uLong)mxGetNumberOfElements(prhs[0]);
+    destlen = compressBound(srclen);
+
+    plhs[0] = mxCreateNumericMatrix(destlen, 1, mxUINT8_CLASS, mxREAL);
+    if (compress2((Bytef*)mxGetData(plhs[0]), &destlen,
+                  (const Bytef*)mxGetData(prhs[0]), srclen, 1) != Z_OK)
+        mexErrMsgIdAndTxt("transplant:zlibcompress:failed",
+                          "zlib compression failed");
+
+    mxSetM(plhs[0], destlen); /* shrink to the actual length */
+}
@@ -0,0 +1,33 @@
+/* ZLIBDECOMPRESS_MEX decompresses zlib-compressed uint8s
+ *
+ * This is the compiled half of the compression codec negotiated by
+ * the 'compress_threshold' option. The expected decompressed length
+ * travels in the message, so the output can be allocated in one
+ * piece. Compile it with build_transplant_mex.m (requires -lz);
+ * transplant_remote falls back to the Java codec if this file is not
+ * compiled.
+ */
+
+/* This code is licensed under the BSD 3-clause license */
+
+#include <zlib.h>
+#include "mex.h"
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+    uLong srclen;
+    uLongf destlen;
+
+    if (nrhs != 2 || !mxIsUint8(prhs[0]) || !mxIsNumeric(prhs[1]))
+        mexErrMsgIdAndTxt("transplant:zlibdecompress:argument",
+                          "zlibdecompress_mex requires a uint8 array "
+                          "and the decompressed length");
+    srclen = (uLong)mxGetNumberOfElements(prhs[0]);
+    destlen = (uLongf)mxGetScalar(prhs[1]);
+
+    plhs[0] = mxCreateNumericMatrix(destlen, 1, mxUINT8_CLASS, mxREAL);
+    if (uncompress((Bytef*)mxGetData(plhs[0]), &destlen,
+                   (const Bytef*)mxGetData(prhs[0]), srclen) != Z_OK)
+        mexErrMsgIdAndTxt("transplant:zlibdecompress:failed",
+                          "zlib decompression failed");
+}